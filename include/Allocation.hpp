@@ -0,0 +1,235 @@
+#ifndef ALLOCATION_H
+#define ALLOCATION_H
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <thread>
+
+#include "Matrix.hpp"
+#include "Ownership.hpp"
+
+namespace gm {
+using namespace std;
+
+/**
+ * @brief How the memory of a matrix is asked from the OS. Each part is best effort,
+ * AllocStats tells what was actually obtained. None set: varray's malloc
+ */
+struct AllocPolicy
+{
+	bool huge; // 2 MiB pages: reserved ones (hugetlbfs) if any, else transparent (madvise)
+	bool interleave; // pages spread round robin over the NUMA nodes (mbind)
+	bool populate; // pages faulted in when allocated, not on first use
+	bool parallelTouch; // pages first touched by all threads, each its own slice
+
+	AllocPolicy() : huge(false), interleave(false), populate(false), parallelTouch(false) {}
+	bool any() const { return huge || interleave || populate || parallelTouch; }
+};
+
+/**
+ * @brief What an allocation with an AllocPolicy got
+ */
+struct AllocStats
+{
+	size_t bytes; // mapped
+	size_t hugeBytes; // backed by huge pages, when last measured
+	bool hugeTLB; // reserved huge pages, all of bytes
+	bool advisedHuge; // transparent huge pages accepted by madvise
+	size_t nodes; // NUMA nodes interleaved over, 0 if not
+	bool populated; // faulted in when allocated
+	size_t touchThreads; // threads that first touched the pages, 0 if not touched
+
+	AllocStats() : bytes(0), hugeBytes(0), hugeTLB(false), advisedHuge(false),
+		nodes(0), populated(false), touchThreads(0) {}
+};
+
+/**
+ * @brief NUMA nodes present, from sysfs
+ * @param mask return value, bit i set if node i exists (first 64)
+ */
+inline size_t numaNodes(unsigned long& mask){
+	char path[64];
+	size_t nodes = 0;
+	mask = 0;
+	for(size_t i = 0; i < 64; ++i){
+		snprintf(path, sizeof(path), "/sys/devices/system/node/node%zu", i);
+		if(access(path, F_OK) == 0){
+			mask |= 1UL << i;
+			++nodes;
+		}
+	}
+	return nodes;
+}
+
+/**
+ * @brief Bytes of the mapping at p backed by transparent huge pages, from /proc/self/smaps
+ */
+inline size_t residentHuge(void* p){
+	FILE* smaps = fopen("/proc/self/smaps", "r");
+	if(smaps == NULL)
+		return 0;
+	char line[256];
+	bool inside = false;
+	size_t kib = 0;
+	uintptr_t addr = (uintptr_t)p;
+	while(fgets(line, sizeof(line), smaps)){
+		unsigned long start, end;
+		if(sscanf(line, "%lx-%lx ", &start, &end) == 2)
+			inside = start <= addr && addr < end;
+		else if(inside && sscanf(line, "AnonHugePages: %zu kB", &kib) == 1)
+			break;
+	}
+	fclose(smaps);
+	return kib*1024;
+}
+
+/**
+ * @brief Writes 0 to every page of p, split in slices between threads.
+ * A page is placed on the node of the thread that touches it first
+ */
+inline void touchPages(char* p, size_t bytes, size_t threads){
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t slice = (bytes/threads + page-1)/page*page;
+	auto touch = [&](size_t t){
+		size_t begin = t*slice, end = begin + slice < bytes ? begin + slice : bytes;
+		if(begin < end)
+			memset(p + begin, 0, end - begin);
+	};
+	vector<thread> pool;
+	for(size_t t = 1; t < threads; ++t)
+		pool.push_back(thread(touch, t));
+	touch(0);
+	for(size_t t = 0; t < pool.size(); ++t)
+		pool[t].join();
+}
+
+/**
+ * @brief Maps at least bytes of zeroed memory following policy
+ * @param stats return value, what was obtained; stats.bytes is the length to unmap
+ * @return the memory, aligned to a huge page if policy.huge; NULL if mmap failed
+ */
+inline void* mapPages(size_t bytes, const AllocPolicy& policy, AllocStats& stats){
+	const size_t hugeSize = 2 << 20;
+	const int prot = PROT_READ | PROT_WRITE;
+	// huge page and NUMA advice only apply to pages not faulted in yet
+	bool advise = policy.huge || policy.interleave;
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	if(policy.populate && not advise)
+		flags |= MAP_POPULATE;
+	stats = AllocStats();
+	stats.bytes = policy.huge ? (bytes + hugeSize-1)/hugeSize*hugeSize : bytes;
+
+	void* p = MAP_FAILED;
+	if(policy.huge){
+		p = mmap(NULL, stats.bytes, prot, flags | MAP_HUGETLB, -1, 0);
+		stats.hugeTLB = p != MAP_FAILED;
+	}
+	if(p == MAP_FAILED){
+		// one huge page more, to align the start to one: THP only backs aligned 2 MiB
+		size_t extra = policy.huge ? hugeSize : 0;
+		char* raw = (char*)mmap(NULL, stats.bytes + extra, prot, flags, -1, 0);
+		if(raw == MAP_FAILED)
+			return NULL;
+		char* q = policy.huge ? (char*)(((uintptr_t)raw + hugeSize-1) & ~(uintptr_t)(hugeSize-1)) : raw;
+		if(q > raw)
+			munmap(raw, q - raw);
+		if(raw + extra > q)
+			munmap(q + stats.bytes, raw + extra - q);
+		p = q;
+		if(policy.huge)
+			stats.advisedHuge = madvise(p, stats.bytes, MADV_HUGEPAGE) == 0;
+	}
+	if(policy.interleave){
+		// MPOL_INTERLEAVE, numaif.h (libnuma) may not be installed
+		const int interleave = 3;
+		unsigned long mask;
+		size_t nodes = numaNodes(mask);
+		if(nodes > 1 && syscall(SYS_mbind, p, stats.bytes, interleave, &mask, 65, 0) == 0)
+			stats.nodes = nodes;
+	}
+	stats.populated = flags & MAP_POPULATE;
+	size_t threads = 0;
+	if(policy.parallelTouch)
+		threads = thread::hardware_concurrency() > 0 ? thread::hardware_concurrency() : 1;
+	else if(policy.populate && advise)
+		threads = 1;
+	if(threads > 0){
+		touchPages((char*)p, bytes, threads);
+		stats.touchThreads = threads;
+		stats.populated = true;
+	}
+	stats.hugeBytes = stats.hugeTLB ? stats.bytes : residentHuge(p);
+	return p;
+}
+
+/**
+ * @brief Square matrix whose memory follows an AllocPolicy, Mat being Matrix or MatrixColMajor.
+ * The elements are mmap'ed and given to the varray of Mat, which never frees them
+ */
+template<class Elem, template<class> class Mat = Matrix>
+class Placed : public Mat<Elem>
+{
+	AllocStats mStats;
+	void* mMap;
+
+	void release(){
+		if(mMap != NULL)
+			munmap(mMap, mStats.bytes);
+		mMap = NULL;
+	}
+public:
+	Placed() : mMap(NULL) {}
+	Placed(size_t size, const AllocPolicy& policy) : mMap(NULL) {
+		alloc(size, policy);
+	}
+	~Placed(){
+		release();
+	}
+	Placed(const Placed&) = delete;
+	Placed& operator=(const Placed&) = delete;
+	/** @brief Sets size to n elems, mapped following policy (if existed: frees old memory) */
+	void alloc(size_t size, const AllocPolicy& policy){
+		release();
+		mStats = AllocStats();
+		// sets the sizes; large malloc'ed blocks are mapped lazily, freed untouched
+		Mat<Elem>::alloc(size);
+		if(not policy.any())
+			return;
+		varray<Elem>& v = Internals<Elem>::array(*this);
+		mMap = mapPages(v.sizeMem()*sizeof(Elem), policy, mStats);
+		if(mMap == NULL){
+			fprintf(stderr, "Could not map %zu bytes, keeping malloc memory\n", v.sizeMem()*sizeof(Elem));
+			return;
+		}
+		// unmapped by release(), after Mat<Elem>::alloc or the destructor of the varray
+		Internals<Elem>::adopt(v, (Elem*)mMap);
+	}
+	/** @brief true if the memory was mapped following a policy, not malloc'ed */
+	bool mapped() const { return mMap != NULL; }
+	/** @brief What the allocation got, huge pages measured again as they may come on first use */
+	const AllocStats& allocStats(){
+		if(mMap != NULL && not mStats.hugeTLB)
+			mStats.hugeBytes = residentHuge(mMap);
+		return mStats;
+	}
+};
+
+/**
+ * @brief Prints stats in a line of comment, in KiB
+ */
+inline void printAllocStats(const char* name, const AllocStats& stats){
+	cout<<"# Alocacao "<< name <<": "<< stats.bytes/1024 <<" KiB, paginas grandes "<< stats.hugeBytes/1024
+		<<" KiB ("<< (stats.hugeTLB ? "hugetlbfs" : stats.advisedHuge ? "THP" : "nao") <<")"
+		<<", nos NUMA "<< stats.nodes
+		<<", populada "<< (stats.populated ? "sim" : "nao")
+		<<", threads primeiro toque "<< stats.touchThreads <<"\n";
+}
+
+
+}
+#endif
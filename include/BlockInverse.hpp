@@ -0,0 +1,214 @@
+#ifndef BLOCKINVERSE_H
+#define BLOCKINVERSE_H
+
+#include "Matrix.hpp"
+#include "GaussEl.hpp"
+#include "SolveLU.hpp"
+#include "MatrixView.hpp"
+#include "Workspace.hpp"
+
+namespace gm {
+using namespace std;
+
+/**
+ * @brief C += sign*A*B, all of them row major, any of them may be rectangular
+ * (MatrixRect, MatrixView): vectorized on the rows of B and C, each elem of A
+ * times a vec of a row of B, so no operand is copied nor transposed. \n
+ * Tiling on L0, SSE, unrolling on i,j
+ * @param iunr rows of C unrolled, junr vecs of the rows of C unrolled
+ */
+template<ssize_t iunr, ssize_t junr, class AMatrix, class BMatrix, class CMatrix>
+inline void multAddKernel(AMatrix& A, BMatrix& B, CMatrix& C, double sign){
+	typedef typename ElemOf<CMatrix>::type Elem;
+	ssize_t rows = nRows(C), cols = nCols(C), inner = nCols(A);
+	ssize_t bi[5], bj[5], bk[5];
+	ssize_t bstep[5];
+	vec<Elem> acc[iunr*junr];
+	vec<Elem> a[iunr] = {}; // elems of A broadcast, sign folded in
+	const vec<Elem>* b; // vecs of the B row
+	bstep[0] = tuning().residue.tileOf<Elem>();
+	bstep[1] = tileL2<Elem>(bstep[0]);
+	bstep[2] = tileL3<Elem>(bstep[1]);
+	ssize_t i, j, k, jv, jvmax;
+	ssize_t vn = C.vecN(); // number of elements on the register (vectorization)
+	
+#define vect(v) for(size_t v = 0; v < regSize<Elem>(); ++v) // broadcast, all the lanes
+#define unrll(u,step) for(size_t u = 0; u < step; ++u) // ease unrolling
+#define unr(iu,iunr,ju,junr) unrll(iu,iunr) unrll(ju,junr) // unroll 2 dimensions
+	
+	for (bi[2] = 0; bi[2] < rows; bi[2] += bstep[2]) // L3 tiling
+	for (bj[2] = 0; bj[2] < cols; bj[2] += bstep[2])
+	for (bk[2] = 0; bk[2] < inner; bk[2] += bstep[2])
+	for (bi[1] = bi[2]; bi[1] < min(bi[2]+bstep[2], rows); bi[1] += bstep[1]) // L2 tiling
+	for (bj[1] = bj[2]; bj[1] < min(bj[2]+bstep[2], cols); bj[1] += bstep[1])
+	for (bk[1] = bk[2]; bk[1] < min(bk[2]+bstep[2], inner); bk[1] += bstep[1])
+	for (bi[0] = bi[1]; bi[0] < min(bi[1]+bstep[1], rows); bi[0] += bstep[0]) // L1 tiling
+	for (bj[0] = bj[1]; bj[0] < min(bj[1]+bstep[1], cols); bj[0] += bstep[0])
+	for (bk[0] = bk[1]; bk[0] < min(bk[1]+bstep[1], inner); bk[0] += bstep[0]){
+		ssize_t imax = min(bi[0]+bstep[0], rows); // setting tile limits
+		ssize_t jmax = min(bj[0]+bstep[0], cols);
+		ssize_t kmax = min(bk[0]+bstep[0], inner);
+		assert(bj[0] % vn == 0); // tiles are made of whole vecs
+		jvmax = jmax/vn;
+		for (i = bi[0]; i < imax -(iunr-1); i += iunr) { // i unroll
+// Multiply current tile: i,jv += A krow * B kvec
+// For (i,jv): from i to i+iunr; from jv to jv+junr
+#define kloop(iunr, junr)	\
+				unr(iu,iunr,ju,junr) acc[iu*junr + ju] = vec<Elem>{};	\
+				for (k = bk[0]; k < kmax; ++k) {	\
+					unrll(iu,iunr) { Elem x = sign*A.at(i+iu, k); vect(v) a[iu][v] = x; }	\
+					b = &B.atv(k, jv);	\
+					unr(iu,iunr,ju,junr)	\
+					acc[iu*junr+ju].v += a[iu].v * b[ju].v;	\
+				}	\
+				unr(iu,iunr,ju,junr) C.atv(i+iu, jv+ju).v += acc[iu*junr+ju].v;
+// vect remainder, the last columns of C
+#define jrem(iunr)	\
+				for (j = jvmax*vn; j < jmax; ++j)	\
+					for (k = bk[0]; k < kmax; ++k)	\
+						unrll(iu,iunr) C.at(i+iu, j) += sign*A.at(i+iu, k) * B.at(k, j);
+// end define
+			for (jv = bj[0]/vn; jv < jvmax -(junr-1); jv += junr) { // j unroll
+				kloop(iunr, junr)
+			}
+			for (jv = jv; jv < jvmax; ++jv) { // j unroll reminder
+				kloop(iunr, 1)
+			}
+			jrem(iunr)
+		}
+		for (i = i; i < imax; ++i) { // i unroll remainder
+			for (jv = bj[0]/vn; jv < jvmax -(junr-1); jv += junr) { // j unroll
+				kloop(1, junr)
+			}
+			for (jv = jv; jv < jvmax; ++jv) { // j unroll reminder
+				kloop(1, 1)
+			}
+			jrem(1)
+		}
+	}
+#undef vect
+#undef unrll
+#undef unr
+#undef kloop
+#undef jrem
+}
+/**
+ * @brief C += sign*A*B, multAddKernel with the unrolling of the residue in tuning(),
+ * compiled for the instruction set of the host, see dispatch()
+ */
+template<class AMatrix, class BMatrix, class CMatrix>
+inline void multAdd(AMatrix& A, BMatrix& B, CMatrix& C, double sign){
+	typedef typename ElemOf<CMatrix>::type Elem;
+	const KernelTuning& tuned = tuning().residue;
+#define call(iunr, junr) dispatch([&]{ multAddKernel<iunr, junr>(A, B, C, sign); })
+	unrolled(call, Elem, tuned.iunr, tuned.junr)
+#undef call
+}
+
+/** @brief Size of the first block blockInverse splits size in, aligned to the cache line */
+inline size_t blockHalf(size_t size){
+	return roundUpMultiple((size+1)/2, (size_t)L1_LINE_DN);
+}
+/** @brief Largest diagonal block blockInverse inverts with the LU decomposition */
+inline size_t blockLeaf(size_t size, size_t crossover){
+	if(size <= crossover)
+		return size;
+	size_t m = blockHalf(size);
+	size_t first = blockLeaf(m, crossover), second = blockLeaf(size - m, crossover);
+	return first > second ? first : second;
+}
+
+/**
+ * @brief Inverts A recursively by 2x2 blocks and their Schur complement:
+ * A = [A11 A12; A21 A22], X11 = A11^-1, T = X11*A12, S = A22 - A21*T \n
+ * IA = [X11 - T*IA21, -T*S^-1; -S^-1*A21*X11, S^-1] \n
+ * Almost all the work is in 6 multiplications of about half size (multAdd).
+ * The blocks of A are views, never copied; X11 and S^-1 are found in place,
+ * in the blocks of IA. There's no pivoting between blocks,
+ * the result must be checked by its residue
+ * @param A row major view
+ * @param IA row major view, return value, no init needed
+ * @param crossover below this size, inverts with the LU decomposition
+ * @param ws shared by all the blocks inverted with the LU, reserved to
+ * blockLeaf() rounded up to the cache line, R() holding the identity.
+ * A block of size s uses the top left s x s of LU(), the rest of it set to
+ * the identity, and the first s columns of the others
+ * @param P LU pivot permutation, ws.size() elems
+ * @return false if a diagonal block (A11 or S) is singular, IA is then invalid
+ */
+template<class AMatrix, class IAMatrix>
+bool blockInverse(MatrixView<AMatrix> A, MatrixView<IAMatrix> IA, size_t crossover,
+InverseWorkspace<double>& ws, varray<size_t>& P){
+	size_t size = A.rows();
+	if(size <= crossover){
+		size_t n = ws.size();
+		Matrix<double>& LU = ws.LU();
+		MatrixView< Matrix<double> > LUs(LU, 0, 0, size, size), LUn(LU, 0, 0, n, n);
+		if(not GaussElChecked(A, LUs, P))
+			return false;
+		// decoupled from the rows and columns past size, left by larger blocks
+		for(size_t i = 0; i < n; ++i)
+			for(size_t j = (i < size ? size : 0); j < n; ++j)
+				LU.at(i,j) = (i == j);
+		for(size_t i = size; i < n; ++i)
+			P.at(i) = i;
+		// views of n rows, the padding past them is never walked
+		MatrixView< MatrixColMajor<double> > I(ws.R(), 0, 0, n, size);
+		MatrixView< MatrixColMajor<double> > Z(ws.Z(), 0, 0, n, size), X(ws.W(), 0, 0, n, size);
+		substMLU0AU<Direction::Forwards, Diagonal::Unit, Permute::True>(LUn, Z, I, P);
+		substMLU0AU<Direction::Backwards, Diagonal::Value, Permute::False>(LUn, X, Z, P);
+		copyRect(IA, X);
+		return true;
+	}
+	size_t m = blockHalf(size);
+	size_t r = size - m;
+	
+	MatrixView<AMatrix> A12 = A.block(0, m, m, r), A21 = A.block(m, 0, r, m);
+	MatrixView<IAMatrix> X11 = IA.block(0, 0, m, m), IA12 = IA.block(0, m, m, r);
+	MatrixView<IAMatrix> IA21 = IA.block(m, 0, r, m), Y = IA.block(m, m, r, r);
+	MatrixRect<double> T(m, r), S(r, r), V(r, m);
+	
+	if(not blockInverse(A.block(0, 0, m, m), X11, crossover, ws, P))
+		return false;
+	// T = X11*A12
+	fillRect(T, 0);
+	multAdd(X11, A12, T, +1);
+	// S = A22 - A21*T
+	MatrixView<AMatrix> A22 = A.block(m, m, r, r);
+	copyRect(S, A22);
+	multAdd(A21, T, S, -1);
+	if(not blockInverse(view(S), Y, crossover, ws, P))
+		return false;
+	// IA21 = -Y*A21*X11
+	fillRect(V, 0);
+	multAdd(A21, X11, V, +1);
+	fillRect(IA21, 0);
+	multAdd(Y, V, IA21, -1);
+	// IA11 = X11 - T*IA21
+	multAdd(T, IA21, X11, -1);
+	// IA12 = -T*Y
+	fillRect(IA12, 0);
+	multAdd(T, Y, IA12, -1);
+	return true;
+}
+
+/**
+ * @brief Calculates inverse of A into IA with blockInverse
+ * @param IA return value, no init needed
+ * @return false if blockInverse met a singular block, IA is then untouched
+ */
+template<class AMatrix, class IAMatrix>
+bool inverse_block(AMatrix& A, IAMatrix& IA, size_t crossover){
+	Matrix<double> X(A.size());
+	InverseWorkspace<double> ws;
+	ws.reserve(roundUpMultiple(blockLeaf(A.size(), crossover), (size_t)L1_LINE_DN));
+	varray<size_t> P(ws.size());
+	assign(ws.R(), IdentityExpr<double>());
+	if(not blockInverse(view(A), view(X), crossover, ws, P))
+		return false;
+	assign(IA, X);
+	return true;
+}
+
+}
+#endif
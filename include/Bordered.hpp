@@ -0,0 +1,207 @@
+#ifndef BORDERED_H
+#define BORDERED_H
+
+#include <vector>
+#include <cmath>
+#include <cfloat>
+
+#include "Matrix.hpp"
+#include "Ownership.hpp"
+
+namespace gm {
+using namespace std;
+
+/**
+ * @brief Square matrix that changes size in place, Mat being Matrix or MatrixColMajor.
+ * Rows/columns are strided by the reserved capacity, sizeMem(), so growing or
+ * shrinking within it keeps every element where it is; beyond it the capacity doubles. \n
+ * Can be moved, not copied: clone() copies
+ */
+template<class Elem, template<class> class Mat = Matrix>
+class Growable : public Mat<Elem>
+{
+	/** @brief Only the logical size changes, the capacity becomes padding */
+	void setSize(size_t size){
+		Internals<Elem>::setSize(*this, size);
+	}
+public:
+	Growable(){
+		Internals<Elem>::clear(*this);
+	}
+	/** @param capacity rows/columns reserved, at least size */
+	Growable(size_t size, size_t capacity = 0){
+		alloc(size, capacity);
+	}
+	Growable(Growable&& other){
+		Internals<Elem>::clear(*this);
+		Internals<Elem>::swap(*this, other);
+	}
+	Growable& operator=(Growable&& other){
+		Internals<Elem>::swap(*this, other);
+		return *this;
+	}
+	Growable(const Growable&) = delete;
+	Growable& operator=(const Growable&) = delete;
+
+	/** @brief Sets size to n elems reserving capacity (if existed: frees old varray pointer) */
+	void alloc(size_t size, size_t capacity = 0){
+		Mat<Elem>::alloc(capacity > size ? capacity : size);
+		setSize(size);
+	}
+	/** @brief n of rows/columns it can grow to without reallocating */
+	size_t capacity() const { return this->sizeMem(); }
+	/** @brief Reallocates to at least capacity rows/columns keeping the elements, O(n*n) */
+	void reserve(size_t capacity){
+		if(capacity <= this->sizeMem())
+			return;
+		size_t size = this->size();
+		Growable grown(size, capacity);
+		for(size_t i = 0; i < size; ++i)
+			for(size_t j = 0; j < size; ++j)
+				grown.at(i,j) = this->at(i,j);
+		Internals<Elem>::swap(*this, grown);
+	}
+	/** @brief New rows/columns are not initialized, O(1) within capacity() */
+	void resize(size_t size){
+		if(size > capacity())
+			reserve(size > 2*capacity() ? size : 2*capacity());
+		setSize(size);
+	}
+	/** @brief Deep copy, same size and capacity */
+	Growable clone(){
+		size_t size = this->size();
+		Growable copy(size, capacity());
+		for(size_t i = 0; i < size; ++i)
+			for(size_t j = 0; j < size; ++j)
+				copy.at(i,j) = this->at(i,j);
+		return copy;
+	}
+};
+
+/**
+ * @brief Removes row and column k of M in place, shifting the next ones back
+ */
+template<class Elem, template<class> class Mat>
+void removeRowCol(Growable<Elem, Mat>& M, size_t k){
+	size_t size = M.size();
+	// (i',j') >= (i,j) in both indexes, never overwritten before it is read
+	for(size_t i = 0; i < size-1; ++i)
+		for(size_t j = 0; j < size-1; ++j)
+			M.at(i,j) = M.at(i + (i >= k), j + (j >= k));
+	M.resize(size-1);
+}
+
+/**
+ * @brief Removes elem k of x in place, shifting the next ones back
+ */
+template<class Elem>
+void removeAt(GrowableArray<Elem>& x, size_t k){
+	for(size_t i = k; i+1 < x.size(); ++i)
+		x.at(i) = x.at(i+1);
+	x.resize(x.size()-1);
+}
+
+/**
+ * @brief Updates IA, inverse of the n*n A, to the inverse of the bordered matrix \n
+ * [ A   u ] \n
+ * [ v^T d ] \n
+ * with x = IA*u, y^T = v^T*IA and the Schur complement s = d - v^T*x: \n
+ * [ IA + x*y^T/s   -x/s ] \n
+ * [ -y^T/s          1/s ] \n
+ * O(n*n) instead of O(n*n*n) for the new inverse
+ * @param IA column major, grows to n+1
+ * @param u, v new column and row of A, A.size() elems
+ * @param d new diagonal elem
+ * @return false if s is too small to divide by, IA is left untouched
+ */
+template<template<class> class Mat>
+bool border_append(Growable<double, Mat>& IA, varray<double>& u, varray<double>& v, double d){
+	ssize_t size = IA.size();
+	ssize_t i, j, iv;
+	ssize_t vn = IA.vecN();
+	varray<double> x(size), y(size);
+
+	// x = IA*u, axpy on each IA column
+	for(i = 0; i < size; ++i)
+		x.at(i) = 0;
+	for(j = 0; j < size; ++j){
+		vec<double> uj;
+		for(ssize_t w = 0; w < vn; ++w) uj[w] = u.at(j);
+		for(iv = 0; iv < x.sizeVec(); ++iv) // vect loop
+			x.atv(iv).v += IA.atv(iv,j).v * uj.v;
+		for(i = x.remStart(); i < size; ++i) // vect remainder
+			x.at(i) += IA.at(i,j) * u.at(j);
+	}
+	// y = v^T*IA, dot of v with each IA column
+	for(j = 0; j < size; ++j){
+		vec<double> acc{0};
+		for(iv = 0; iv < v.sizeVec(); ++iv) // vect loop
+			acc.v += v.atv(iv).v * IA.atv(iv,j).v;
+		y.at(j) = 0;
+		for(i = v.remStart(); i < size; ++i) // vect remainder
+			y.at(j) += v.at(i) * IA.at(i,j);
+		for(ssize_t w = 0; w < vn; ++w) // vect result sum
+			y.at(j) += acc[w];
+	}
+	// Schur complement of A, compared to the magnitude of what cancelled in it
+	double s = d, mag = abs(d);
+	for(i = 0; i < size; ++i){
+		s -= v.at(i) * x.at(i);
+		mag += abs(v.at(i) * x.at(i));
+	}
+	if(abs(s) <= mag*DBL_EPSILON*size)
+		return false;
+	double is = 1/s;
+
+	// IA += x*y^T/s, axpy on each IA column
+	for(j = 0; j < size; ++j){
+		vec<double> yj;
+		for(ssize_t w = 0; w < vn; ++w) yj[w] = y.at(j) * is;
+		for(iv = 0; iv < x.sizeVec(); ++iv) // vect loop
+			IA.atv(iv,j).v += x.atv(iv).v * yj.v;
+		for(i = x.remStart(); i < size; ++i) // vect remainder
+			IA.at(i,j) += x.at(i) * y.at(j) * is;
+	}
+	IA.resize(size+1);
+	for(i = 0; i < size; ++i){
+		IA.at(i,size) = -x.at(i) * is;
+		IA.at(size,i) = -y.at(i) * is;
+	}
+	IA.at(size,size) = is;
+	return true;
+}
+
+/**
+ * @brief Updates IA, inverse of A, to the inverse of A without row and column k. \n
+ * With b = IA(:,k), c^T = IA(k,:) and h = IA(k,k) the result is
+ * IA - b*c^T/h without row and column k, O(n*n)
+ * @param IA shrinks to n-1
+ * @return false if h is zero, A without row and column k is singular
+ */
+template<template<class> class Mat>
+bool border_remove(Growable<double, Mat>& IA, size_t k){
+	size_t size = IA.size();
+	size_t i, j;
+	double h = IA.at(k,k);
+	if(h == 0)
+		return false;
+	varray<double> b(size), c(size);
+	for(i = 0; i < size; ++i){
+		b.at(i) = IA.at(i,k) / h;
+		c.at(i) = IA.at(k,i);
+	}
+	// row and column k are kept in b and c, (i',j') >= (i,j) is read before written
+	for(j = 0; j < size-1; ++j){
+		size_t jo = j + (j >= k);
+		for(i = 0; i < size-1; ++i){
+			size_t io = i + (i >= k);
+			IA.at(i,j) = IA.at(io,jo) - b.at(io) * c.at(jo);
+		}
+	}
+	IA.resize(size-1);
+	return true;
+}
+
+
+}
+#endif
@@ -0,0 +1,133 @@
+#ifndef COMPONENTS_H
+#define COMPONENTS_H
+
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+
+#include "Matrix.hpp"
+#include "GaussEl.hpp"
+#include "Subst.hpp"
+#include "SolveLU.hpp"
+
+namespace gm {
+using namespace std;
+
+/**
+ * @brief Union-find root of i, halving the path on the way
+ */
+inline size_t findRoot(vector<size_t>& parent, size_t i){
+	while(parent[i] != i){
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+
+/**
+ * @brief Groups the indexes of A into the connected components of its nonzero pattern,
+ * A(i,j) != 0 joins i and j. A restricted to the rows and columns of each group
+ * is a diagonal block, the permuted A is block diagonal. O(n*n), stops as soon as
+ * one component spans A: O(n) for a dense A
+ * @param blocks return value, indexes of each component in increasing order
+ */
+template<class AMatrix>
+void components(AMatrix& A, vector< vector<size_t> >& blocks){
+	size_t size = A.size();
+	vector<size_t> parent(size), block(size, size);
+	size_t count = size; // components left
+	for(size_t i = 0; i < size; ++i)
+		parent[i] = i;
+	for(size_t i = 0; i < size && count > 1; ++i){
+		for(size_t j = 0; j < size && count > 1; ++j){
+			if(i != j && A.at(i,j) != 0){
+				size_t ri = findRoot(parent, i), rj = findRoot(parent, j);
+				if(ri != rj){
+					parent[ri > rj ? ri : rj] = ri > rj ? rj : ri;
+					--count;
+				}
+			}
+		}
+	}
+	blocks.clear();
+	for(size_t i = 0; i < size; ++i){
+		size_t r = findRoot(parent, i);
+		if(block[r] == size){
+			block[r] = blocks.size();
+			blocks.push_back(vector<size_t>());
+		}
+		blocks[block[r]].push_back(i);
+	}
+}
+
+/**
+ * @brief Calculates inverse of A into IA with inverse_refining on its own workspace,
+ * not reporting: many can run at once in different threads
+ * @param IA return value, no init needed
+ * @param residue return value, norm of the residue of IA
+ * @return false if A is singular, IA is then invalid
+ */
+template<class AMatrix, class IAMatrix>
+bool inverse_local(AMatrix& A, IAMatrix& IA, long iter_n, double& residue){
+	InverseWorkspace<typename ElemOf<AMatrix>::type> ws;
+	ws.reserve(A.size());
+	varray<size_t> P(A.sizeMem());
+	if(not GaussElChecked(A, ws.LU(), P))
+		return false;
+	residue = inverse_refining(A, ws.LU(), IA, P, iter_n, ws, false);
+	return true;
+}
+
+/**
+ * @brief Inverts the block diagonal (after permuting) A by its diagonal blocks,
+ * each gathered into its own Matrix, inverted with inverse_local and scattered into IA.
+ * The blocks are independent, worker threads take them largest first
+ * @param blocks indexes of each diagonal block, from components()
+ * @param residues return value, residue norm of each block inverse
+ * @param threads number of worker threads
+ * @return false if a block is singular, A is then too and IA is invalid
+ */
+template<class AMatrix, class IAMatrix>
+bool inverse_components(AMatrix& A, IAMatrix& IA, vector< vector<size_t> >& blocks,
+long iter_n, vector<double>& residues, size_t threads){
+	vector<size_t> order(blocks.size());
+	for(size_t b = 0; b < blocks.size(); ++b)
+		order[b] = b;
+	sort(order.begin(), order.end(), [&](size_t a, size_t b){ return blocks[a].size() > blocks[b].size(); });
+	residues.assign(blocks.size(), 0);
+	assign(IA, 0.0);
+
+	atomic<size_t> next(0);
+	atomic<bool> singular(false);
+	auto worker = [&](){
+		// each IA elem belongs to one block, the threads never write the same one
+		for(size_t o = next++; o < order.size() && not singular; o = next++){
+			vector<size_t>& idx = blocks[order[o]];
+			size_t m = idx.size();
+			Matrix<double> Ab(m);
+			MatrixColMajor<double> Xb(m);
+			for(size_t i = 0; i < m; ++i)
+				for(size_t j = 0; j < m; ++j)
+					Ab.at(i,j) = A.at(idx[i], idx[j]);
+			if(not inverse_local(Ab, Xb, iter_n, residues[order[o]])){
+				singular = true;
+				break;
+			}
+			for(size_t j = 0; j < m; ++j)
+				for(size_t i = 0; i < m; ++i)
+					IA.at(idx[i], idx[j]) = Xb.at(i,j);
+		}
+	};
+	vector<thread> pool;
+	for(size_t t = 1; t < threads; ++t)
+		pool.push_back(thread(worker));
+	worker();
+	for(size_t t = 0; t < pool.size(); ++t)
+		pool[t].join();
+	return not singular;
+}
+
+
+}
+#endif
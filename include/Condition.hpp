@@ -0,0 +1,208 @@
+#ifndef CONDITION_H
+#define CONDITION_H
+
+#include <cmath>
+#include <vector>
+
+#include "Matrix.hpp"
+#include "Subst.hpp"
+#include "Elem.hpp"
+
+namespace gm {
+using namespace std;
+
+/**
+ * @brief Read only conjugate transposed access to a matrix, so subst can solve with LU^T
+ * (LU^H if complex)
+ */
+template<class Mat>
+struct Transposed {
+	typedef typename ElemOf<Mat>::type Elem;
+	Mat& M;
+	Transposed(Mat& M) : M(M) {}
+	size_t size() const { return M.size(); }
+	Elem at(size_t i, size_t j) const { return conjOf(M.at(j, i)); }
+};
+
+/**
+ * @brief Solves A*X = B using the LU decomposition, single column
+ * @param Z work vector, LU.size() elems
+ */
+template<class LUMatrix, class Elem>
+inline void solveLUv(LUMatrix& LU, varray<Elem>& X, varray<Elem>& B, varray<size_t>& P, varray<Elem>& Z){
+	// find Z; LZ=PB
+	subst<Direction::Forwards, Diagonal::Unit, Permute::True>(LU, Z, B, P, 0);
+	// find X; UX=Z
+	subst<Direction::Backwards, Diagonal::Value, Permute::False>(LU, X, Z, P, 0);
+}
+
+/**
+ * @brief Solves A^T*X = B (A^H*X = B if complex) using the LU decomposition of A, single column. \n
+ * A^T = U^T L^T P, so solves U^T and L^T then undoes the permutation
+ * @param Z work vector, LU.size() elems
+ */
+template<class LUMatrix, class Elem>
+inline void solveLUTv(LUMatrix& LU, varray<Elem>& X, varray<Elem>& B, varray<size_t>& P, varray<Elem>& Z){
+	Transposed<LUMatrix> LUT(LU);
+	// find Z; U^T Z = B
+	subst<Direction::Forwards, Diagonal::Value, Permute::False>(LUT, Z, B, P, 0);
+	// find PX; L^T PX = Z
+	subst<Direction::Backwards, Diagonal::Unit, Permute::False>(LUT, B, Z, P, 0);
+	for(size_t i = 0; i < LU.size(); ++i)
+		X.at(P.at(i)) = B.at(i);
+}
+
+/**
+ * @return 1-norm of A, maximum absolute column sum
+ * @param S work vector, A.size() elems
+ */
+template<class AMatrix, class Elem>
+double norm1(AMatrix& A, varray<Elem>& S){
+	size_t size = A.size();
+	for(size_t j = 0; j < size; ++j)
+		S.at(j) = 0;
+	for(size_t i = 0; i < size; ++i)
+		for(size_t j = 0; j < size; ++j)
+			S.at(j) += abs(A.at(i,j));
+	double norm = 0;
+	for(size_t j = 0; j < size; ++j)
+		norm = max(norm, (double)abs(S.at(j)));
+	return norm;
+}
+template<class AMatrix>
+double norm1(AMatrix& A){
+	varray<typename ElemOf<AMatrix>::type> S(A.size());
+	return norm1(A, S);
+}
+
+/**
+ * @brief Estimates the 1-norm of A^-1 from the LU decomposition of A,
+ * Hager's method with Higham's refinements (LAPACK xLACON). \n
+ * Each step is a solve with A and one with A^T, O(n*n),
+ * no more than 5 steps are done. Complex A: Higham's complex variant, with A^H
+ * @param LU decomposition of A
+ * @param P LU pivot permutation
+ * @param X, Y, Z, W work vectors, LU.size() elems
+ * @return Lower bound of |A^-1|, usually within a factor of 3
+ */
+template<class LUMatrix, class Elem>
+double normInv1Estimate(LUMatrix& LU, varray<size_t>& P,
+varray<Elem>& X, varray<Elem>& Y, varray<Elem>& Z, varray<Elem>& W){
+	const size_t maxIter = 5;
+	size_t size = LU.size();
+	size_t i, j, iter;
+	double est = 0, yNorm;
+	
+	for(i = 0; i < size; ++i)
+		X.at(i) = 1.0/size;
+	for(iter = 0; iter < maxIter; ++iter){
+		solveLUv(LU, Y, X, P, W);
+		yNorm = 0;
+		for(i = 0; i < size; ++i)
+			yNorm += abs(Y.at(i));
+		if(iter > 0 && yNorm <= est)
+			break; // no improvement
+		est = yNorm;
+		// Y = sign(Y); Z = A^-T sign(Y)
+		for(i = 0; i < size; ++i)
+			Y.at(i) = signOf(Y.at(i));
+		solveLUTv(LU, Z, Y, P, W);
+		size_t jmax = 0;
+		double ztx = 0;
+		for(j = 0; j < size; ++j){
+			if(abs(Z.at(j)) > abs(Z.at(jmax))) jmax = j;
+			ztx += real(conjOf(Z.at(j))*X.at(j));
+		}
+		if(iter > 0 && abs(Z.at(jmax)) <= ztx)
+			break; // local maximum
+		// next X = e_jmax
+		for(i = 0; i < size; ++i)
+			X.at(i) = 0;
+		X.at(jmax) = 1;
+	}
+	// alternative estimate, guards against the cases the method fails
+	for(i = 0; i < size; ++i)
+		X.at(i) = (i % 2 ? -1.0 : 1.0) * (1.0 + (double)i/max(size-1, (size_t)1));
+	solveLUv(LU, Y, X, P, W);
+	yNorm = 0;
+	for(i = 0; i < size; ++i)
+		yNorm += abs(Y.at(i));
+	return max(est, 2*yNorm/(3*size));
+}
+template<class LUMatrix>
+double normInv1Estimate(LUMatrix& LU, varray<size_t>& P){
+	size_t size = LU.size();
+	varray<typename ElemOf<LUMatrix>::type> X(size), Y(size), Z(size), W(size);
+	return normInv1Estimate(LU, P, X, Y, Z, W);
+}
+
+/**
+ * @brief Estimates the 1-norm condition number of A, O(n*n)
+ * @param LU decomposition of A
+ * @param P LU pivot permutation
+ */
+template<class AMatrix, class LUMatrix>
+double cond1Estimate(AMatrix& A, LUMatrix& LU, varray<size_t>& P){
+	return norm1(A) * normInv1Estimate(LU, P);
+}
+/**
+ * @param X, Y, Z, W work vectors, A.size() elems
+ */
+template<class AMatrix, class LUMatrix, class Elem>
+double cond1Estimate(AMatrix& A, LUMatrix& LU, varray<size_t>& P,
+varray<Elem>& X, varray<Elem>& Y, varray<Elem>& Z, varray<Elem>& W){
+	return norm1(A, X) * normInv1Estimate(LU, P, X, Y, Z, W);
+}
+
+
+/**
+ * @brief Sign of the permutation P, +1 if even, -1 if odd, from the length of its cycles
+ * @param size number of elems of P used, the padding is not permuted
+ */
+template<class Perm>
+int permutationSign(Perm& P, size_t size){
+	vector<char> visited(size, 0);
+	int sign = 1;
+	for(size_t i = 0; i < size; ++i){
+		if(visited[i])
+			continue;
+		// a cycle of length l is l-1 transpositions
+		for(size_t j = P[i]; j != i; j = P[j]){
+			visited[j] = 1;
+			sign = -sign;
+		}
+		visited[i] = 1;
+	}
+	return sign;
+}
+
+/**
+ * @brief log|det(A)| from its LU decomposition, sum of the logs of the pivots,
+ * which doesn't overflow or underflow like their product. O(n)
+ * @param sign return value, sign of det(A): the pivots' and P's; 0 if A is singular
+ * @return log|det(A)|, -inf if singular
+ */
+template<class LUMatrix>
+double logDeterminant(LUMatrix& LU, varray<size_t>& P, int& sign){
+	size_t size = LU.size();
+	vector<size_t> perm(size);
+	for(size_t i = 0; i < size; ++i)
+		perm[i] = P.at(i);
+	sign = permutationSign(perm, size);
+	double logDet = 0;
+	for(size_t i = 0; i < size; ++i){
+		double u = LU.at(i,i);
+		if(u == 0){
+			sign = 0;
+			return -HUGE_VAL;
+		}
+		if(u < 0)
+			sign = -sign;
+		logDet += log(abs(u));
+	}
+	return logDet;
+}
+
+
+}
+#endif
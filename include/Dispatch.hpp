@@ -0,0 +1,92 @@
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include <string.h>
+
+namespace gm {
+using namespace std;
+
+/**
+ * @brief Instruction sets the hot kernels are compiled for, in increasing order.
+ * The rest of the binary is built for the baseline ISA of the Makefile
+ */
+enum class Isa { Generic, AVX2, AVX512 };
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+// the kernel and everything it calls are inlined and compiled again for the target
+#define GM_TARGET_AVX2 __attribute__((target("avx2,fma"), flatten))
+#define GM_TARGET_AVX512 __attribute__((target("avx512f,avx512vl,avx512dq,avx512bw,avx2,fma,prefer-vector-width=512"), flatten))
+#define GM_DISPATCH 1
+#else
+#define GM_DISPATCH 0
+#endif
+
+/** @brief Widest Isa the CPU and the OS support, from cpuid */
+inline Isa detectIsa(){
+#if GM_DISPATCH
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl")
+	&& __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512bw"))
+		return Isa::AVX512;
+	if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		return Isa::AVX2;
+#endif
+	return Isa::Generic;
+}
+
+/** @brief Isa the kernels run, detected on first use */
+inline Isa& selectedIsa(){
+	static Isa isa = detectIsa();
+	return isa;
+}
+inline Isa activeIsa(){ return selectedIsa(); }
+
+/**
+ * @brief Runs the kernels with isa instead of the detected one, e.g. to compare them
+ * @return false if the CPU doesn't support isa, nothing changes
+ */
+inline bool setIsa(Isa isa){
+	if(isa > detectIsa())
+		return false;
+	selectedIsa() = isa;
+	return true;
+}
+
+inline const char* isaName(Isa isa){
+	return isa == Isa::AVX512 ? "avx512" : isa == Isa::AVX2 ? "avx2" : "generic";
+}
+/** @return false if name is not an Isa */
+inline bool isaFromName(const char* name, Isa& isa){
+	if(strcmp(name, "generic") == 0) isa = Isa::Generic;
+	else if(strcmp(name, "avx2") == 0) isa = Isa::AVX2;
+	else if(strcmp(name, "avx512") == 0) isa = Isa::AVX512;
+	else return false;
+	return true;
+}
+
+#if GM_DISPATCH
+template<class Kernel>
+GM_TARGET_AVX2 void runAVX2(const Kernel& kernel){ kernel(); }
+template<class Kernel>
+GM_TARGET_AVX512 void runAVX512(const Kernel& kernel){ kernel(); }
+#endif
+
+/**
+ * @brief Calls kernel() compiled for activeIsa(): one binary runs the widest code
+ * each host supports. kernel is a lambda calling the kernel, capturing its arguments
+ */
+template<class Kernel>
+inline void dispatch(const Kernel& kernel){
+#if GM_DISPATCH
+	switch(activeIsa()){
+		case Isa::AVX512: runAVX512(kernel); return;
+		case Isa::AVX2: runAVX2(kernel); return;
+		default: break;
+	}
+#endif
+	kernel();
+}
+
+
+}
+#endif
@@ -0,0 +1,127 @@
+#ifndef ELEM_H
+#define ELEM_H
+
+#include <complex>
+#include <type_traits>
+#include <utility>
+
+#include "Double.h"
+#include "Matrix.hpp"
+
+/** @brief close_zero of Double.h for complex elems, on their magnitude */
+template<class T>
+inline bool close_zero(std::complex<T> x){ return close_zero((double)std::abs(x)); }
+
+namespace gm {
+using namespace std;
+
+/** @brief Elem type of the matrix Mat, from its at(i,j) */
+template<class Mat>
+struct ElemOf {
+	typedef typename remove_cv<typename remove_reference<
+		decltype(declval<Mat&>().at(0,0))>::type>::type type;
+};
+
+/** @brief Type of the magnitudes of Elem: itself for float and double, T for complex<T> */
+template<class Elem>
+struct RealOf { typedef Elem type; };
+template<class T>
+struct RealOf< complex<T> > { typedef T type; };
+
+/**
+ * @brief N complex numbers packed as the vector type of a vec, elementwise operations.
+ * gcc vector extensions only take arithmetic types, the kernels use this the same way
+ */
+template<class T, size_t N>
+struct ComplexPack
+{
+	complex<T> c[N];
+
+	ComplexPack& operator+=(const ComplexPack& b){
+		for(size_t k = 0; k < N; ++k) c[k] += b.c[k];
+		return *this;
+	}
+	ComplexPack& operator-=(const ComplexPack& b){
+		for(size_t k = 0; k < N; ++k) c[k] -= b.c[k];
+		return *this;
+	}
+	ComplexPack& operator*=(const ComplexPack& b){
+		for(size_t k = 0; k < N; ++k) c[k] *= b.c[k];
+		return *this;
+	}
+	friend ComplexPack operator+(ComplexPack a, const ComplexPack& b){ return a += b; }
+	friend ComplexPack operator-(ComplexPack a, const ComplexPack& b){ return a -= b; }
+	friend ComplexPack operator*(ComplexPack a, const ComplexPack& b){ return a *= b; }
+};
+
+/**
+ * @brief vec of complex elems, regSize<complex<T>>() of them in REG_SZ bytes,
+ * laid out as in varray
+ */
+template<class T>
+struct vec< complex<T> >
+{
+	ComplexPack<T, REG_SZ/sizeof(complex<T>)> v;
+
+	inline const complex<T>& operator[] (size_t i) const {
+		assert(i < regSize< complex<T> >() && "Vectorized elem out of register access");
+		return v.c[i];
+	}
+	inline complex<T>& operator[] (size_t i) {
+		assert(i < regSize< complex<T> >() && "Vectorized elem out of register access");
+		return v.c[i];
+	}
+};
+
+/** @brief Complex conjugate of x, x itself if real */
+template<class Elem>
+Elem conjOf(Elem x){ return x; }
+template<class T>
+complex<T> conjOf(complex<T> x){ return conj(x); }
+
+/** @brief conjOf of each elem of x */
+template<class Elem>
+vec<Elem> conjv(const vec<Elem>& x){ return x; }
+template<class T>
+vec< complex<T> > conjv(const vec< complex<T> >& x){
+	vec< complex<T> > y;
+	for(size_t k = 0; k < regSize< complex<T> >(); ++k)
+		y[k] = conj(x[k]);
+	return y;
+}
+
+/** @brief |x|^2 */
+template<class Elem>
+Elem absSq(Elem x){ return x*x; }
+template<class T>
+T absSq(complex<T> x){ return norm(x); }
+
+/** @brief x/|x|: +1 or -1 if real, 1 for 0 */
+template<class Elem>
+Elem signOf(Elem x){ return x >= 0 ? 1 : -1; }
+template<class T>
+complex<T> signOf(complex<T> x){ return abs(x) == 0 ? complex<T>(1) : x/abs(x); }
+
+/** @brief Random elem in [0,1), real and imaginary parts if complex */
+template<class Elem>
+struct RandomElem { static Elem get(){ return (Elem)((double)rand()/(double)RAND_MAX); } };
+template<class T>
+struct RandomElem< complex<T> > {
+	static complex<T> get(){
+		T re = RandomElem<T>::get();
+		return complex<T>(re, RandomElem<T>::get());
+	}
+};
+template<class Elem>
+Elem randomElem(){ return RandomElem<Elem>::get(); }
+
+/** @brief Name of Elem, for the output */
+template<class Elem> const char* elemName();
+template<> inline const char* elemName<float>(){ return "float"; }
+template<> inline const char* elemName<double>(){ return "double"; }
+template<> inline const char* elemName< complex<float> >(){ return "complex<float>"; }
+template<> inline const char* elemName< complex<double> >(){ return "complex<double>"; }
+
+
+}
+#endif
@@ -0,0 +1,114 @@
+#ifndef EQUILIBRATE_H
+#define EQUILIBRATE_H
+
+#include <cmath>
+#include <vector>
+
+#include "Matrix.hpp"
+
+namespace gm {
+using namespace std;
+
+/**
+ * @return power of 2 nearest to 1/x, scaling by it is exact
+ */
+inline double scale2(double x){
+	int exp;
+	if(x == 0) return 1;
+	frexp(x, &exp);
+	return ldexp(1.0, -exp);
+}
+
+/**
+ * @brief Equilibrates A in place, A = diag(Rs)*A*diag(Cs), as LAPACK xGEEQU. \n
+ * Rows are scaled so their largest element is near 1, then columns the same.
+ * Scales are powers of 2, no rounding is introduced. O(n*n), vectorized
+ * @param A row major
+ * @param Rs return value, row scales, A.size() elems
+ * @param Cs return value, column scales, A.size() elems
+ */
+template<class AMatrix>
+void equilibrate(AMatrix& A, varray<double>& Rs, varray<double>& Cs){
+	ssize_t size = A.size();
+	ssize_t i, j, jv;
+	ssize_t vn = Cs.vecN();
+	
+#define vect(v) for(ssize_t v=0; v < vn; ++v) // ease vectorization
+	
+	for(j = 0; j < size; ++j)
+		Cs.at(j) = 0;
+	for(i = 0; i < size; ++i){
+		// row scale
+		double rmax = 0;
+		for(j = 0; j < size; ++j)
+			rmax = max(rmax, abs(A.at(i,j)));
+		Rs.at(i) = scale2(rmax);
+		// max of the scaled columns
+		vec<double> r;
+		vect(v) r[v] = Rs.at(i);
+		for(jv = 0; jv < Cs.sizeVec(); ++jv){ // vect loop
+			vec<double> a;
+			a.v = A.atv(i,jv).v * r.v;
+			a.v = a.v < 0 ? -a.v : a.v;
+			Cs.atv(jv).v = a.v > Cs.atv(jv).v ? a.v : Cs.atv(jv).v;
+		}
+		for(j = Cs.remStart(); j < size; ++j) // vect remainder
+			Cs.at(j) = max(Cs.at(j), abs(A.at(i,j)*Rs.at(i)));
+	}
+	for(j = 0; j < size; ++j)
+		Cs.at(j) = scale2(Cs.at(j));
+	// A = diag(Rs)*A*diag(Cs)
+	for(i = 0; i < size; ++i){
+		vec<double> r;
+		vect(v) r[v] = Rs.at(i);
+		for(jv = 0; jv < Cs.sizeVec(); ++jv) // vect loop
+			A.atv(i,jv).v *= Cs.atv(jv).v * r.v;
+		for(j = Cs.remStart(); j < size; ++j) // vect remainder
+			A.at(i,j) *= Cs.at(j) * Rs.at(i);
+	}
+#undef vect
+}
+
+/**
+ * @brief Undoes the equilibration on the inverse:
+ * A^-1 = diag(Cs)*As^-1*diag(Rs), O(n*n), vectorized
+ * @param IA column major, inverse of the equilibrated matrix
+ * @param Rs, Cs scales given by equilibrate
+ */
+template<class IAMatrix>
+void unequilibrate(IAMatrix& IA, varray<double>& Rs, varray<double>& Cs){
+	ssize_t size = IA.size();
+	ssize_t i, j, iv;
+	ssize_t vn = Cs.vecN();
+	
+#define vect(v) for(ssize_t v=0; v < vn; ++v) // ease vectorization
+	
+	for(j = 0; j < size; ++j){
+		vec<double> r;
+		vect(v) r[v] = Rs.at(j);
+		for(iv = 0; iv < Cs.sizeVec(); ++iv) // vect loop
+			IA.atv(iv,j).v *= Cs.atv(iv).v * r.v;
+		for(i = Cs.remStart(); i < size; ++i) // vect remainder
+			IA.at(i,j) *= Cs.at(i) * Rs.at(j);
+	}
+#undef vect
+}
+
+/**
+ * @brief Equilibrates the update A + U*V^T like A:
+ * diag(Rs)*(A + U*V^T)*diag(Cs) = As + (diag(Rs)*U)*(diag(Cs)*V)^T. O(n*k)
+ * @param U, V columns of the update, A.size() elems each
+ * @param Rs, Cs scales given by equilibrate
+ */
+template<class Vec>
+void equilibrateUpdate(vector<Vec>& U, vector<Vec>& V, varray<double>& Rs, varray<double>& Cs){
+	for(size_t c = 0; c < U.size(); ++c)
+		for(size_t i = 0; i < Rs.size(); ++i){
+			U[c].at(i) *= Rs.at(i);
+			V[c].at(i) *= Cs.at(i);
+		}
+}
+
+
+}
+#endif
@@ -0,0 +1,247 @@
+#ifndef EXPRESSION_H
+#define EXPRESSION_H
+
+#include <type_traits>
+
+#include "Matrix.hpp"
+#include "MatrixView.hpp"
+
+namespace gm {
+using namespace std;
+
+/**
+ * @brief Storage order an expression can be evaluated in with atv:
+ * that of its matrices, Any if it has none, Mixed if they differ
+ */
+enum class Order { Row, Col, Any, Mixed };
+
+/** @brief Order of an expression with operands in orders a and b */
+constexpr Order combine(Order a, Order b){
+	return a == Order::Any ? b : b == Order::Any ? a : a == b ? a : Order::Mixed;
+}
+
+/**
+ * @brief Base of the nodes of lazily evaluated elementwise matrix expressions, E the node. \n
+ * Operators only build the nodes, assign() evaluates the whole expression in a single
+ * pass over the destination: each node has at(i,j) and atv<colMajor>(x,i,j), writing
+ * into x the vec i of column j if colMajor else vec j of row i, computed from its
+ * operands' ones. \n
+ * No vector type is passed nor returned by value: without AVX enabled that changes
+ * the ABI (-Wpsabi)
+ */
+template<class E>
+struct Expr {
+	const E& self() const { return static_cast<const E&>(*this); }
+};
+
+/** @brief Leaf referencing a matrix, no elems are copied */
+template<class Mat>
+struct Terminal : Expr< Terminal<Mat> > {
+	typedef typename remove_const<typename IsColMajor<Mat>::Elem>::type Elem;
+	static constexpr Order order = IsColMajor<Mat>::value ? Order::Col : Order::Row;
+	const Mat& M;
+
+	Terminal(const Mat& M) : M(M) {}
+	Elem at(size_t i, size_t j) const { return M.at(i,j); }
+	template<bool colMajor>
+	void atv(vec<Elem>& x, size_t i, size_t j) const { x = M.atv(i,j); }
+};
+
+/** @brief Leaf of the same value x in every elem */
+template<class T>
+struct Scalar : Expr< Scalar<T> > {
+	typedef T Elem;
+	static constexpr Order order = Order::Any;
+	Elem x;
+	vec<Elem> xv; // x broadcast
+
+	Scalar(Elem x) : x(x) {
+		for(size_t v = 0; v < regSize<Elem>(); ++v)
+			xv[v] = x;
+	}
+	Elem at(size_t i, size_t j) const { return x; }
+	template<bool colMajor>
+	void atv(vec<Elem>& x, size_t i, size_t j) const { x = xv; }
+};
+
+/** @brief Leaf of the identity matrix */
+template<class T>
+struct IdentityExpr : Expr< IdentityExpr<T> > {
+	typedef T Elem;
+	static constexpr Order order = Order::Any;
+
+	Elem at(size_t i, size_t j) const { return i == j; }
+	template<bool colMajor>
+	void atv(vec<Elem>& x, size_t i, size_t j) const {
+		size_t vn = regSize<Elem>();
+		for(size_t v = 0; v < vn; ++v)
+			x[v] = 0;
+		// position of the diagonal in this vec, none if it wraps around
+		size_t d = colMajor ? j - i*vn : i - j*vn;
+		if(d < vn)
+			x[d] = 1;
+	}
+};
+
+/** @brief Elementwise operations x = a Op b, on elems and on the vector type of vecs alike */
+struct Plus { template<class T> static void apply(T& x, const T& a, const T& b){ x = a + b; } };
+struct Minus { template<class T> static void apply(T& x, const T& a, const T& b){ x = a - b; } };
+struct Times { template<class T> static void apply(T& x, const T& a, const T& b){ x = a * b; } };
+
+/** @brief Elementwise l Op r */
+template<class L, class R, class Op>
+struct Binary : Expr< Binary<L, R, Op> > {
+	typedef typename L::Elem Elem;
+	static constexpr Order order = combine(L::order, R::order);
+	L l;
+	R r;
+
+	Binary(const L& l, const R& r) : l(l), r(r) {}
+	Elem at(size_t i, size_t j) const {
+		Elem x;
+		Op::apply(x, l.at(i,j), r.at(i,j));
+		return x;
+	}
+	template<bool colMajor>
+	void atv(vec<Elem>& x, size_t i, size_t j) const {
+		vec<Elem> a, b;
+		l.template atv<colMajor>(a, i, j);
+		r.template atv<colMajor>(b, i, j);
+		Op::apply(x.v, a.v, b.v);
+	}
+};
+
+/**
+ * @brief Matrix product A*B, not elementwise: only valid as E - A*B,
+ * which assign() evaluates with E written inside multSub0AUIJ
+ */
+template<class AMatrix, class BMatrix>
+struct Product : Expr< Product<AMatrix, BMatrix> > {
+	typedef typename Terminal<AMatrix>::Elem Elem;
+	static constexpr Order order = Order::Mixed;
+	const AMatrix& A;
+	const BMatrix& B;
+
+	Product(const AMatrix& A, const BMatrix& B) : A(A), B(B) {}
+};
+
+/** @brief true if T has atv(i,j), as the matrices and views */
+template<class T, class = void>
+struct HasAtv : false_type {};
+template<class T>
+struct HasAtv<T, decltype(declval<const T&>().atv(0,0), void())> : true_type {};
+
+/** @brief Node of an operand: nodes stay as they are, matrices become Terminals */
+template<class T, class = void>
+struct NodeOf {};
+template<class T>
+struct NodeOf<T, typename enable_if<is_base_of<Expr<T>, T>::value>::type> {
+	typedef T type;
+	static const T& make(const T& e){ return e; }
+};
+template<class T>
+struct NodeOf<T, typename enable_if<not is_base_of<Expr<T>, T>::value && HasAtv<T>::value>::type> {
+	typedef Terminal<T> type;
+	static Terminal<T> make(const T& M){ return Terminal<T>(M); }
+};
+
+template<class L, class R, class Op>
+using BinaryOf = Binary<typename NodeOf<L>::type, typename NodeOf<R>::type, Op>;
+template<class T, class Op>
+using ScaledOf = Binary<Scalar<typename NodeOf<T>::type::Elem>, typename NodeOf<T>::type, Op>;
+
+template<class L, class R>
+BinaryOf<L, R, Plus> operator+(const L& l, const R& r){
+	return BinaryOf<L, R, Plus>(NodeOf<L>::make(l), NodeOf<R>::make(r));
+}
+template<class L, class R>
+BinaryOf<L, R, Minus> operator-(const L& l, const R& r){
+	return BinaryOf<L, R, Minus>(NodeOf<L>::make(l), NodeOf<R>::make(r));
+}
+template<class T>
+ScaledOf<T, Plus> operator+(typename NodeOf<T>::type::Elem x, const T& t){
+	return ScaledOf<T, Plus>(x, NodeOf<T>::make(t));
+}
+template<class T>
+ScaledOf<T, Minus> operator-(typename NodeOf<T>::type::Elem x, const T& t){
+	return ScaledOf<T, Minus>(x, NodeOf<T>::make(t));
+}
+template<class T>
+ScaledOf<T, Times> operator*(typename NodeOf<T>::type::Elem x, const T& t){
+	return ScaledOf<T, Times>(x, NodeOf<T>::make(t));
+}
+template<class T>
+ScaledOf<T, Times> operator-(const T& t){
+	typedef typename NodeOf<T>::type::Elem Elem;
+	return ScaledOf<T, Times>(Elem(-1), NodeOf<T>::make(t));
+}
+/** @brief Product of two matrices, see Product */
+template<class AMatrix, class BMatrix>
+typename enable_if<not is_base_of<Expr<AMatrix>, AMatrix>::value && HasAtv<AMatrix>::value
+	&& not is_base_of<Expr<BMatrix>, BMatrix>::value && HasAtv<BMatrix>::value,
+	Product<AMatrix, BMatrix> >::type
+operator*(const AMatrix& A, const BMatrix& B){
+	return Product<AMatrix, BMatrix>(A, B);
+}
+
+/**
+ * @brief M = expr in a single pass: a vectorized loop over atv in M's storage order,
+ * scalar if the matrices of expr are in other orders. \n
+ * M may be one of the operands, each elem is read before it is written
+ * @param M Matrix, MatrixColMajor, MatrixRect or MatrixView, allocated
+ */
+template<class Mat, class E>
+void assign(Mat& M, const Expr<E>& expr){
+	const E& e = expr.self();
+	const bool colMajor = IsColMajor<Mat>::value;
+	const bool vectorized = E::order == Order::Any || E::order == (colMajor ? Order::Col : Order::Row);
+	size_t rows = nRows(M), cols = nCols(M);
+	size_t vn = M.vecN();
+	size_t i, j, iv, jv;
+	if(vectorized && colMajor){
+		for(j = 0; j < cols; ++j){
+			for(iv = 0; iv < rows/vn; ++iv) // vect loop
+				e.template atv<colMajor>(M.atv(iv,j), iv, j);
+			for(i = iv*vn; i < rows; ++i) // vect remainder
+				M.at(i,j) = e.at(i,j);
+		}
+	} else if(vectorized){
+		for(i = 0; i < rows; ++i){
+			for(jv = 0; jv < cols/vn; ++jv) // vect loop
+				e.template atv<colMajor>(M.atv(i,jv), i, jv);
+			for(j = jv*vn; j < cols; ++j) // vect remainder
+				M.at(i,j) = e.at(i,j);
+		}
+	} else if(colMajor){
+		for(j = 0; j < cols; ++j)
+			for(i = 0; i < rows; ++i)
+				M.at(i,j) = e.at(i,j);
+	} else {
+		for(i = 0; i < rows; ++i)
+			for(j = 0; j < cols; ++j)
+				M.at(i,j) = e.at(i,j);
+	}
+}
+/**
+ * @brief M = E - A*B in one pass: E is written per tile of M inside
+ * multSub0AUIJ, before its first product; M must not be A nor B
+ */
+template<class Mat, class L, class AMatrix, class BMatrix>
+void assign(Mat& M, const Binary<L, Product<AMatrix, BMatrix>, Minus>& expr){
+	multSub0AUIJ(expr.r.A, expr.r.B, M, expr.l);
+}
+/** @brief M = A, A a matrix */
+template<class Mat, class AMatrix>
+typename enable_if<not is_base_of<Expr<AMatrix>, AMatrix>::value && HasAtv<AMatrix>::value>::type
+assign(Mat& M, const AMatrix& A){
+	assign(M, Terminal<AMatrix>(A));
+}
+/** @brief Sets all elems of M to x */
+template<class Mat>
+void assign(Mat& M, typename Terminal<Mat>::Elem x){
+	assign(M, Scalar<typename Terminal<Mat>::Elem>(x));
+}
+
+
+}
+#endif
@@ -3,19 +3,46 @@
 
 #include "Double.h"
 #include "Matrix.hpp"
+#include "MatrixView.hpp"
+#include "Elem.hpp"
+#include "Dispatch.hpp"
 
 namespace gm {
 using namespace std;
 
+/**
+ @brief Row i of LU -= m * row p of LU, from column k0 on.
+ Each contiguous run of the rows (a tile of a MatrixTiled) is walked through pointers
+ */
+template<class LUMatrix, class Elem>
+inline void subRow(LUMatrix& LU, size_t i, size_t p, size_t k0, Elem m){
+	size_t size = LU.size();
+	for(size_t k = k0; k < size; ){
+		size_t run = min(size - k, contiguousFrom(LU, k));
+		Elem* li = &LU.at(i, k);
+		const Elem* lp = &LU.at(p, k);
+		for(size_t r = 0; r < run; r++){
+			li[r] -= lp[r] * m;
+		}
+		k += run;
+	}
+}
+
 /**
  @brief For the matrix LU finds its LU decomposition overwriting it
  Has partial pivoting, stores final indexes in P
  @param LU Matrix to be decomposed Output: lower triangle of this matrix will store L 1 diagonal implicit, upper triangle stores U
  @param P Permutation vector resulting of the pivoting
+ @return false if a pivot is 0, the matrix is singular and LU is invalid
  */
-inline void GaussEl(const Matrix<double>& A, Matrix<double>& LU, varray<size_t>& P) {
-	// copy A to LU
-	set(LU, A);
+template<class AMatrix, class LUMatrix>
+inline bool GaussElKernel(const AMatrix& A, LUMatrix& LU, varray<size_t>& P) {
+	// copy A to LU, through at(): the layouts may differ
+	for(size_t i = 0; i < A.size(); i++){
+		for(size_t j = 0; j < A.size(); j++){
+			LU.at(i,j) = A.at(i,j);
+		}
+	}
 	// initializing permutation vector
 	for(size_t i = 0; i < A.sizeMem(); i++){
 		P.at(i) = i;
@@ -34,8 +61,7 @@ inline void GaussEl(const Matrix<double>& A, Matrix<double>& LU, varray<size_t>&
 		swap(P.at(p), P.at(maxRow));
 
 		if(close_zero(LU.at(p,p))){
-			fprintf(stderr, "Found a pivot == 0, system is not solvable with partial pivoting");
-			exit(EXIT_FAILURE);
+			return false;
 		}
 		// LU.at(p,p) = 1; implicit
 		//for(size_t i = p+1; i < A.size; i++){	// going from pivot+1 to end
@@ -45,16 +71,92 @@ inline void GaussEl(const Matrix<double>& A, Matrix<double>& LU, varray<size_t>&
 				// find pivot multiplier, store in L
 				LU.at(i, p) = LU.at(i, p)/LU.at(p, p);
 				// subtract pivot row U.at(p, _) from current row LU.at(i, _)
-				for(size_t k = p+1; k < A.size(); k++){
-					LU.at(i, k) -= LU.at(p, k) * LU.at(i, p);
-					// mulitply pivot line value to multiplier
-				}
+				// mulitply pivot line value to multiplier
+				subRow(LU, i, p, p+1, LU.at(i, p));
 			} else {
 				// pivot not subtracted from line
 				LU.at(i, p) = 0.0;
 			}
 		}
 	}
+	return true;
+}
+/**
+ * @brief GaussElKernel compiled for the instruction set of the host, see dispatch()
+ * @return false if the matrix is singular, for callers that can recover
+ */
+template<class AMatrix, class LUMatrix>
+inline bool GaussElChecked(const AMatrix& A, LUMatrix& LU, varray<size_t>& P) {
+	bool factored;
+	dispatch([&]{ factored = GaussElKernel(A, LU, P); });
+	return factored;
+}
+/**
+ * @brief GaussElChecked, exits if the matrix is singular
+ */
+template<class AMatrix, class LUMatrix>
+inline void GaussEl(const AMatrix& A, LUMatrix& LU, varray<size_t>& P) {
+	if(not GaussElChecked(A, LU, P)){
+		fprintf(stderr, "Found a pivot == 0, system is not solvable with partial pivoting");
+		exit(EXIT_FAILURE);
+	}
+}
+
+
+/**
+ @brief LU decomposition with the row order fixed up front by P, no pivot search nor row swaps.
+ For matrices with the same structure as the one GaussEl found P for, e.g. time steps of a simulation
+ @param LU Output: L and U as in GaussEl, of A with rows permuted by P
+ @param P Permutation vector from a previous GaussEl, kept
+ @param tol a pivot below tol times the largest elem of its column in A fails
+ @param colMax work vector, A.size() elems of any type holding a magnitude
+ @return false if a pivot fell below the threshold, LU is invalid and GaussEl should pivot again
+ */
+template<class AMatrix, class LUMatrix, class Vec>
+inline bool GaussElStaticKernel(const AMatrix& A, LUMatrix& LU, varray<size_t>& P, double tol, Vec& colMax) {
+	size_t size = A.size();
+	// permuted copy of A, column maxima for the pivot threshold
+	for(size_t j = 0; j < size; j++){
+		colMax.at(j) = 0;
+	}
+	for(size_t i = 0; i < size; i++){
+		for(size_t j = 0; j < size; j++){
+			LU.at(i,j) = A.at(P.at(i),j);
+			if(abs(LU.at(i,j)) > abs(colMax.at(j))) colMax.at(j) = abs(LU.at(i,j));
+		}
+	}
+
+	// for each pivot
+	for(size_t p = 0; p < size; p++){
+		if(close_zero(LU.at(p,p)) || abs(LU.at(p,p)) < tol*abs(colMax.at(p))){
+			return false;
+		}
+		for(size_t i = p+1; i < size; i++){
+			if(not close_zero(LU.at(i,p))){
+				// find pivot multiplier, store in L
+				LU.at(i, p) = LU.at(i, p)/LU.at(p, p);
+				// subtract pivot row U.at(p, _) from current row LU.at(i, _)
+				subRow(LU, i, p, p+1, LU.at(i, p));
+			} else {
+				LU.at(i, p) = 0.0;
+			}
+		}
+	}
+	return true;
+}
+/**
+ * @brief GaussElStaticKernel compiled for the instruction set of the host, see dispatch()
+ */
+template<class AMatrix, class LUMatrix, class Vec>
+inline bool GaussElStatic(const AMatrix& A, LUMatrix& LU, varray<size_t>& P, double tol, Vec& colMax) {
+	bool factored;
+	dispatch([&]{ factored = GaussElStaticKernel(A, LU, P, tol, colMax); });
+	return factored;
+}
+template<class AMatrix, class LUMatrix>
+inline bool GaussElStatic(const AMatrix& A, LUMatrix& LU, varray<size_t>& P, double tol) {
+	varray<double> colMax(A.size());
+	return GaussElStatic(A, LU, P, tol, colMax);
 }
 
 
@@ -0,0 +1,136 @@
+#ifndef MATRIXTILED_H
+#define MATRIXTILED_H
+
+#include <assert.h>
+
+#include "Matrix.hpp"
+#include "MatrixView.hpp"
+
+namespace gm {
+using namespace std;
+
+/**
+ * @brief Stores values of a square matrix in T*T tiles, each contiguous in memory. \n
+ * Tiles are in tile-row order, elems in a tile in row major order:
+ * a kernel working on a tile streams T*T consecutive elems instead of
+ * T rows sizeMem() apart, a page or more away from each other. \n
+ * Same at/atv interface as Matrix, a vec never crosses a tile
+ * @param T tile size, multiple of vecN()
+ */
+template<class Elem, size_t T = 32>
+class MatrixTiled : public Matrix<Elem>
+{
+protected:
+	using Matrix<Elem>::varr;
+	using Matrix<Elem>::mSize;
+	using Matrix<Elem>::mSizeVec;
+	using Matrix<Elem>::mSizeMem;
+	using Matrix<Elem>::mSizeVecMem;
+	using Matrix<Elem>::mPad;
+	using Matrix<Elem>::mEndVec;
+	size_t mTilesMem; // n of tiles per row in memory
+public:
+	/** @brief Sets size to n elems (if existed: frees old varray pointer) */
+	void alloc(size_t size){
+		size_t vn = this->vecN();
+		assert(T % vn == 0);
+		mSize = size;
+		mSizeVec = mSize/vn;
+		mSizeMem = calcPadSize(mSize);
+		mSizeVecMem = mSizeMem/vn;
+		mEndVec = Lower_Multiple(mSize, vn);
+		mPad = mSizeMem - mSize;
+		// the last tiles are partly outside sizeMem(), they are only allocated
+		mTilesMem = (mSizeMem + T-1)/T;
+		varr.alloc(mTilesMem*T * mTilesMem*T);
+	}
+	/** @param size of the matrix, total number of lines */
+	MatrixTiled(size_t size){
+		alloc(size);
+	}
+	MatrixTiled(){}
+
+	/** @brief n of rows/columns of a tile */
+	static constexpr size_t tileN() { return T; }
+	/** @brief n of tiles in a row/column in memory */
+	size_t tilesMem() const { return mTilesMem; }
+	/** @brief First elem of tile (ti,tj), T*T contiguous elems, row major */
+	Elem* tile(size_t ti, size_t tj){
+		assert(ti < mTilesMem && tj < mTilesMem);
+		return &varr.at((ti*mTilesMem + tj)*T*T);
+	}
+
+	size_t indMem(size_t i, size_t j) const {
+		assert(i < mSizeMem && j < mSizeMem);
+		return ((i/T)*mTilesMem + j/T)*T*T + (i%T)*T + j%T;
+	}
+	size_t indVecMem(size_t i, size_t j) const {
+		assert(i < mSizeMem && j < mSizeVecMem);
+		return indMem(i, j*varr.vecN()) / varr.vecN();
+	}
+	vec<Elem>& atv(size_t i, size_t j) {
+		return varr.atv(indVecMem(i,j));
+	}
+	const vec<Elem>& atv(size_t i, size_t j) const {
+		return varr.atv(indVecMem(i,j));
+	}
+	Elem& at(size_t i, size_t j){
+		return varr.at(indMem(i,j));
+	}
+	const Elem& at(size_t i, size_t j) const {
+		return varr.at(indMem(i,j));
+	}
+};
+
+/**
+ * @brief MatrixTiled with tiles in tile-column order, elems in a tile in column major order.
+ * atv(i,j) is a vec of column j, as in MatrixColMajor
+ */
+template<class Elem, size_t T = 32>
+class MatrixTiledColMajor : public MatrixTiled<Elem, T>
+{
+	using MatrixTiled<Elem, T>::varr;
+	using MatrixTiled<Elem, T>::mSizeMem;
+	using MatrixTiled<Elem, T>::mSizeVecMem;
+	using MatrixTiled<Elem, T>::mTilesMem;
+public:
+	using MatrixTiled<Elem, T>::MatrixTiled;
+
+	/** @brief First elem of tile (ti,tj), T*T contiguous elems, column major */
+	Elem* tile(size_t ti, size_t tj){
+		assert(ti < mTilesMem && tj < mTilesMem);
+		return &varr.at((tj*mTilesMem + ti)*T*T);
+	}
+
+	size_t indMem(size_t i, size_t j) const {
+		assert(i < mSizeMem && j < mSizeMem);
+		return ((j/T)*mTilesMem + i/T)*T*T + (j%T)*T + i%T;
+	}
+	size_t indVecMem(size_t i, size_t j) const {
+		assert(i < mSizeVecMem && j < mSizeMem);
+		return indMem(i*varr.vecN(), j) / varr.vecN();
+	}
+	vec<Elem>& atv(size_t i, size_t j) {
+		return varr.atv(indVecMem(i,j));
+	}
+	const vec<Elem>& atv(size_t i, size_t j) const {
+		return varr.atv(indVecMem(i,j));
+	}
+	Elem& at(size_t i, size_t j){
+		return varr.at(indMem(i,j));
+	}
+	const Elem& at(size_t i, size_t j) const {
+		return varr.at(indMem(i,j));
+	}
+};
+
+/** @brief atv of MatrixTiledColMajor is along the columns */
+template<class E, size_t T>
+struct IsColMajor< MatrixTiledColMajor<E, T> > {
+	typedef E Elem;
+	static const bool value = true;
+};
+
+
+}
+#endif
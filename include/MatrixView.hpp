@@ -0,0 +1,240 @@
+#ifndef MATRIXVIEW_H
+#define MATRIXVIEW_H
+
+#include <assert.h>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+#include "Matrix.hpp"
+
+namespace gm {
+using namespace std;
+
+/**
+ * @brief Stores values of a rows*cols matrix in a varray, Row Major Order.
+ * Each row takes ld() elems in memory, its leading dimension, padded as Matrix rows
+ */
+template<class Elem>
+class MatrixRect
+{
+protected:
+	varray<Elem> varr;
+	size_t mRows, mCols;
+	size_t mLd; // n of elems between the start of two rows
+	size_t mLdVec; // n of vec<elem>s between the start of two rows
+public:
+	/** @brief Sets the size (if existed: frees old varray pointer) */
+	void alloc(size_t rows, size_t cols){
+		mRows = rows;
+		mCols = cols;
+		mLd = calcPadSize(cols);
+		mLdVec = mLd/vecN();
+		varr.alloc(rows*mLd);
+	}
+	MatrixRect(size_t rows, size_t cols){
+		alloc(rows, cols);
+	}
+	MatrixRect(){}
+
+	/** @brief n of elems in a vec */
+	size_t vecN() const { return varr.vecN(); }
+	size_t rows() const { return mRows; }
+	size_t cols() const { return mCols; }
+	/** @brief leading dimension, n of elems in a row in memory */
+	size_t ld() const { return mLd; }
+
+	size_t indMem(size_t i, size_t j) const {
+		assert(i < mRows && j < mLd);
+		return i*mLd + j;
+	}
+	size_t indVecMem(size_t i, size_t j) const {
+		assert(i < mRows && j < mLdVec);
+		return i*mLdVec + j;
+	}
+	/** @brief vec j of row i */
+	vec<Elem>& atv(size_t i, size_t j) {
+		return varr.atv(indVecMem(i,j));
+	}
+	const vec<Elem>& atv(size_t i, size_t j) const {
+		return varr.atv(indVecMem(i,j));
+	}
+	Elem& at(size_t i, size_t j){
+		return varr.at(indMem(i,j));
+	}
+	const Elem& at(size_t i, size_t j) const {
+		return varr.at(indMem(i,j));
+	}
+};
+
+/**
+ * @brief MatrixRect in Column Major Order, ld() elems per column in memory
+ */
+template<class Elem>
+class MatrixRectColMajor : public MatrixRect<Elem>
+{
+	using MatrixRect<Elem>::varr;
+	using MatrixRect<Elem>::mRows;
+	using MatrixRect<Elem>::mCols;
+	using MatrixRect<Elem>::mLd;
+	using MatrixRect<Elem>::mLdVec;
+public:
+	void alloc(size_t rows, size_t cols){
+		mRows = rows;
+		mCols = cols;
+		mLd = calcPadSize(rows);
+		mLdVec = mLd/this->vecN();
+		varr.alloc(cols*mLd);
+	}
+	MatrixRectColMajor(size_t rows, size_t cols){
+		alloc(rows, cols);
+	}
+	MatrixRectColMajor(){}
+
+	size_t indMem(size_t i, size_t j) const {
+		assert(i < mLd && j < mCols);
+		return j*mLd + i;
+	}
+	size_t indVecMem(size_t i, size_t j) const {
+		assert(i < mLdVec && j < mCols);
+		return j*mLdVec + i;
+	}
+	/** @brief vec i of column j */
+	vec<Elem>& atv(size_t i, size_t j) {
+		return varr.atv(indVecMem(i,j));
+	}
+	const vec<Elem>& atv(size_t i, size_t j) const {
+		return varr.atv(indVecMem(i,j));
+	}
+	Elem& at(size_t i, size_t j){
+		return varr.at(indMem(i,j));
+	}
+	const Elem& at(size_t i, size_t j) const {
+		return varr.at(indMem(i,j));
+	}
+};
+
+/** @brief n of rows of M: rows() if it has one, else size() of the square matrices */
+template<class Mat>
+auto nRows(const Mat& M, int) -> decltype(M.rows()) { return M.rows(); }
+template<class Mat>
+size_t nRows(const Mat& M, long) { return M.size(); }
+template<class Mat>
+size_t nRows(const Mat& M) { return nRows(M, 0); }
+/** @brief n of columns of M: cols() if it has one, else size() */
+template<class Mat>
+auto nCols(const Mat& M, int) -> decltype(M.cols()) { return M.cols(); }
+template<class Mat>
+size_t nCols(const Mat& M, long) { return M.size(); }
+template<class Mat>
+size_t nCols(const Mat& M) { return nCols(M, 0); }
+/**
+ * @brief n of elems of M contiguous in memory from index k on, along its vectorized
+ * dimension: to the end of the tile if it has tileN(), else all of them
+ */
+template<class Mat>
+auto contiguousFrom(const Mat& M, size_t k, int) -> decltype(M.tileN()) { return M.tileN() - k%M.tileN(); }
+template<class Mat>
+size_t contiguousFrom(const Mat& M, size_t k, long) { return numeric_limits<size_t>::max(); }
+template<class Mat>
+size_t contiguousFrom(const Mat& M, size_t k) { return contiguousFrom(M, k, 0); }
+/** @brief As contiguousFrom, from index k back to the start of its tile, k included */
+template<class Mat>
+auto contiguousTo(const Mat& M, size_t k, int) -> decltype(M.tileN()) { return k%M.tileN() + 1; }
+template<class Mat>
+size_t contiguousTo(const Mat& M, size_t k, long) { return numeric_limits<size_t>::max(); }
+template<class Mat>
+size_t contiguousTo(const Mat& M, size_t k) { return contiguousTo(M, k, 0); }
+
+/** @brief true if the vecs of Mat are along its columns */
+template<class Mat>
+struct IsColMajor {
+	typedef typename remove_reference<decltype(declval<Mat&>().at(0,0))>::type Elem;
+	static const bool value = is_base_of<MatrixColMajor<Elem>, Mat>::value
+		|| is_base_of<MatrixRectColMajor<Elem>, Mat>::value;
+};
+
+/**
+ * @brief Non owning rows*cols block of M starting at (i0,j0), no elems are copied.
+ * Mat is Matrix, MatrixColMajor, MatrixRect or one derived from them. \n
+ * Works with the kernels through at/atv: the vectorized offset, j0 in row major
+ * and i0 in column major, must be a multiple of vecN(). For the square kernels
+ * size() is rows() and there is no padding, sizeMem() == size()
+ */
+template<class Mat>
+class MatrixView
+{
+	typedef typename IsColMajor<Mat>::Elem Elem;
+	static const bool colMajor = IsColMajor<Mat>::value;
+	Mat* M;
+	size_t mI0, mJ0, mRows, mCols;
+	size_t mVecN;
+	size_t mVi0, mVj0; // offsets of atv
+public:
+	MatrixView(Mat& M, size_t i0, size_t j0, size_t rows, size_t cols)
+		: M(&M), mI0(i0), mJ0(j0), mRows(rows), mCols(cols), mVecN(M.vecN()),
+		mVi0(colMajor ? i0/mVecN : i0), mVj0(colMajor ? j0 : j0/mVecN) {
+		assert(i0 + rows <= nRows(M) && j0 + cols <= nCols(M));
+		assert((colMajor ? i0 : j0) % mVecN == 0);
+	}
+	/** @brief rows*cols block of this view starting at (i,j), a view of the same M */
+	MatrixView block(size_t i, size_t j, size_t rows, size_t cols){
+		return MatrixView(*M, mI0 + i, mJ0 + j, rows, cols);
+	}
+
+	size_t rows() const { return mRows; }
+	size_t cols() const { return mCols; }
+	size_t size() const { return mRows; }
+	size_t sizeMem() const { return mRows; }
+	size_t pad() const { return 0; }
+	size_t vecN() const { return mVecN; }
+	/** @brief n of whole vecs along the vectorized dimension */
+	size_t sizeVec() const { return (colMajor ? mRows : mCols)/mVecN; }
+	/** @brief remaining loop start index */
+	size_t remStart() const { return sizeVec()*mVecN; }
+
+	vec<Elem>& atv(size_t i, size_t j) {
+		return M->atv(mVi0 + i, mVj0 + j);
+	}
+	const vec<Elem>& atv(size_t i, size_t j) const {
+		return M->atv(mVi0 + i, mVj0 + j);
+	}
+	Elem& at(size_t i, size_t j){
+		assert(i < mRows && j < mCols);
+		return M->at(mI0 + i, mJ0 + j);
+	}
+	const Elem& at(size_t i, size_t j) const {
+		assert(i < mRows && j < mCols);
+		return M->at(mI0 + i, mJ0 + j);
+	}
+};
+
+/** @brief A view is in the order of its matrix */
+template<class Mat>
+struct IsColMajor< MatrixView<Mat> > : IsColMajor<Mat> {};
+
+/** @brief View of all of M */
+template<class Mat>
+MatrixView<Mat> view(Mat& M){
+	return MatrixView<Mat>(M, 0, 0, nRows(M), nCols(M));
+}
+
+/** @brief Sets all elems of the (rectangular) M to x */
+template<class Mat>
+void fillRect(Mat& M, double x){
+	for(size_t i = 0; i < nRows(M); ++i)
+		for(size_t j = 0; j < nCols(M); ++j)
+			M.at(i,j) = x;
+}
+
+/** @brief Copies the (rectangular) A into M, same shape */
+template<class Mat, class AMatrix>
+void copyRect(Mat& M, AMatrix& A){
+	for(size_t i = 0; i < nRows(M); ++i)
+		for(size_t j = 0; j < nCols(M); ++j)
+			M.at(i,j) = A.at(i,j);
+}
+
+
+}
+#endif
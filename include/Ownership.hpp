@@ -0,0 +1,204 @@
+#ifndef OWNERSHIP_H
+#define OWNERSHIP_H
+
+#include <stdlib.h>
+#include <algorithm>
+
+#include "Matrix.hpp"
+
+namespace gm {
+using namespace std;
+
+/** @brief Members of varray, reachable outside of its hierarchy through pointers to member */
+template<class Elem>
+struct ArrayMembers : varray<Elem> {
+	using varray<Elem>::arr;
+	using varray<Elem>::mSize;
+	using varray<Elem>::mSizeVec;
+	using varray<Elem>::mSizeMem;
+	using varray<Elem>::mSizeVecMem;
+	using varray<Elem>::mPad;
+	using varray<Elem>::mEndVec;
+	using varray<Elem>::mpMem;
+};
+
+/** @brief Members of Matrix, reachable even if a derived class redeclares them private */
+template<class Elem>
+struct MatrixMembers : Matrix<Elem> {
+	using Matrix<Elem>::varr;
+	using Matrix<Elem>::mSize;
+	using Matrix<Elem>::mSizeVec;
+	using Matrix<Elem>::mSizeMem;
+	using Matrix<Elem>::mSizeVecMem;
+	using Matrix<Elem>::mPad;
+	using Matrix<Elem>::mEndVec;
+};
+
+/**
+ * @brief The one place that reaches into the protected members of Grimoire's varray and
+ * Matrix, which can't be resized in place nor moved: GrowableArray, Growable and Placed
+ * change sizes and owners only through it. \n
+ * The static_asserts fail if either class gets a member this doesn't know of
+ */
+template<class Elem>
+struct Internals
+{
+	static_assert(sizeof(varray<Elem>) == sizeof(vecp<Elem>) + 6*sizeof(size_t) + sizeof(void*),
+		"varray layout changed, review Internals");
+	static_assert(sizeof(Matrix<Elem>) == sizeof(varray<Elem>) + 6*sizeof(size_t),
+		"Matrix layout changed, review Internals");
+
+	/** @brief Only the logical size of a changes, the rest of sizeMem() becomes padding */
+	static void setSize(varray<Elem>& a, size_t size){
+		typedef ArrayMembers<Elem> M;
+		size_t vn = a.vecN();
+		a.*(&M::mSize) = size;
+		a.*(&M::mSizeVec) = size/vn;
+		a.*(&M::mEndVec) = Lower_Multiple(size, vn);
+		a.*(&M::mPad) = a.sizeMem() - size;
+	}
+	/** @brief Only the logical size of a changes, the rest of the rows/columns becomes padding */
+	static void setSize(Matrix<Elem>& a, size_t size){
+		typedef MatrixMembers<Elem> M;
+		size_t vn = a.vecN();
+		a.*(&M::mSize) = size;
+		a.*(&M::mSizeVec) = size/vn;
+		a.*(&M::mEndVec) = Lower_Multiple(size, vn);
+		a.*(&M::mPad) = a.sizeMem() - size;
+	}
+	/** @brief The varray holding the elems of a */
+	static varray<Elem>& array(Matrix<Elem>& a){
+		return a.*(&MatrixMembers<Elem>::varr);
+	}
+	/**
+	 * @brief a takes p as its elems, in place of its own: the malloc'ed memory of a
+	 * is freed, and a won't ever free p. Whoever got p (e.g. mmap'ed it) keeps owning it,
+	 * and must release it after a, or alloc a again before.
+	 * @param p a.sizeMem() elems, aligned as varray aligns its own
+	 */
+	static void adopt(varray<Elem>& a, Elem* p){
+		typedef ArrayMembers<Elem> M;
+		free(a.*(&M::mpMem));
+		a.*(&M::mpMem) = NULL;
+		(a.*(&M::arr)).p = p;
+	}
+	/**
+	 * @brief Swaps the memory and sizes of a and b, no elem is copied.
+	 * varray has no move semantics, the owner of the memory changes here
+	 */
+	static void swap(varray<Elem>& a, varray<Elem>& b){
+		typedef ArrayMembers<Elem> M;
+		size_t varray<Elem>::* sizes[] = { &M::mSize, &M::mSizeVec, &M::mSizeMem,
+			&M::mSizeVecMem, &M::mPad, &M::mEndVec };
+		std::swap(a.*(&M::arr), b.*(&M::arr));
+		std::swap(a.*(&M::mpMem), b.*(&M::mpMem));
+		for(size_t k = 0; k < sizeof(sizes)/sizeof(sizes[0]); ++k)
+			std::swap(a.*sizes[k], b.*sizes[k]);
+	}
+	/** @brief Empties a without freeing its memory, its owner must have been swapped out */
+	static void clear(varray<Elem>& a){
+		typedef ArrayMembers<Elem> M;
+		size_t varray<Elem>::* sizes[] = { &M::mSize, &M::mSizeVec, &M::mSizeMem,
+			&M::mSizeVecMem, &M::mPad, &M::mEndVec };
+		(a.*(&M::arr)).p = NULL;
+		a.*(&M::mpMem) = NULL;
+		for(size_t k = 0; k < sizeof(sizes)/sizeof(sizes[0]); ++k)
+			a.*sizes[k] = 0;
+	}
+	/** @brief Swaps the memory and sizes of the matrices a and b, no elem is copied */
+	static void swap(Matrix<Elem>& a, Matrix<Elem>& b){
+		typedef MatrixMembers<Elem> M;
+		size_t Matrix<Elem>::* sizes[] = { &M::mSize, &M::mSizeVec, &M::mSizeMem,
+			&M::mSizeVecMem, &M::mPad, &M::mEndVec };
+		swap(array(a), array(b));
+		for(size_t k = 0; k < sizeof(sizes)/sizeof(sizes[0]); ++k)
+			std::swap(a.*sizes[k], b.*sizes[k]);
+	}
+	/** @brief Empties the matrix a, same as clear of a varray */
+	static void clear(Matrix<Elem>& a){
+		typedef MatrixMembers<Elem> M;
+		size_t Matrix<Elem>::* sizes[] = { &M::mSize, &M::mSizeVec, &M::mSizeMem,
+			&M::mSizeVecMem, &M::mPad, &M::mEndVec };
+		clear(array(a));
+		for(size_t k = 0; k < sizeof(sizes)/sizeof(sizes[0]); ++k)
+			a.*sizes[k] = 0;
+	}
+};
+
+/**
+ * @brief varray that can be moved, cloned and resized in place: capacity() elems are
+ * allocated, resizing within it keeps the memory. Not copyable, clone() copies
+ */
+template<class Elem>
+class GrowableArray : public varray<Elem>
+{
+	using varray<Elem>::mSize;
+	using varray<Elem>::mSizeMem;
+
+	/** @brief Only the logical size changes, the capacity becomes padding */
+	void setSize(size_t size){
+		Internals<Elem>::setSize(*this, size);
+	}
+public:
+	GrowableArray(){
+		Internals<Elem>::clear(*this);
+	}
+	/** @param capacity elems reserved, at least size */
+	GrowableArray(size_t size, size_t capacity = 0){
+		alloc(size, capacity);
+	}
+	GrowableArray(GrowableArray&& other){
+		Internals<Elem>::clear(*this);
+		Internals<Elem>::swap(*this, other);
+	}
+	GrowableArray& operator=(GrowableArray&& other){
+		Internals<Elem>::swap(*this, other);
+		return *this;
+	}
+	GrowableArray(const GrowableArray&) = delete;
+	GrowableArray& operator=(const GrowableArray&) = delete;
+
+	/** @brief Sets size to n elems reserving capacity (if existed: frees old varray pointer) */
+	void alloc(size_t size, size_t capacity = 0){
+		varray<Elem>::alloc(capacity > size ? capacity : size);
+		setSize(size);
+	}
+	/** @brief n of elems it can grow to without reallocating */
+	size_t capacity() const { return mSizeMem; }
+	/** @brief Reallocates to at least capacity elems keeping the elements, O(n) */
+	void reserve(size_t capacity){
+		if(capacity <= mSizeMem)
+			return;
+		GrowableArray grown(mSize, capacity);
+		for(size_t i = 0; i < mSize; ++i)
+			grown.at(i) = this->at(i);
+		Internals<Elem>::swap(*this, grown);
+	}
+	/** @brief New elems are not initialized, O(1) within capacity() */
+	void resize(size_t size){
+		if(size > capacity())
+			reserve(size > 2*capacity() ? size : 2*capacity());
+		setSize(size);
+	}
+	/** @brief Deep copy, same size and capacity */
+	GrowableArray clone() const {
+		GrowableArray copy(mSize, mSizeMem);
+		for(size_t i = 0; i < mSize; ++i)
+			copy.at(i) = this->at(i);
+		return copy;
+	}
+};
+
+/** @brief As a column vector in the subst functions, like varray */
+template<class Elem>
+Elem& at(GrowableArray<Elem>& arr, size_t i, size_t j){
+	return arr.at(i);
+}
+template<class Elem>
+const Elem& at(GrowableArray<Elem> const& arr, size_t i, size_t j){
+	return arr.at(i);
+}
+
+
+}
+#endif
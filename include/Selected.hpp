@@ -0,0 +1,117 @@
+#ifndef SELECTED_H
+#define SELECTED_H
+
+#include <vector>
+#include <cmath>
+
+#include "Matrix.hpp"
+#include "MatrixView.hpp"
+#include "Subst.hpp"
+#include "SolveLU.hpp"
+
+namespace gm {
+using namespace std;
+
+/** @brief Zeroes all of M, the padding rows included: the substitutions go through them */
+template<class Elem>
+void zeroRect(MatrixRectColMajor<Elem>& M){
+	for(size_t j = 0; j < M.cols(); ++j)
+		for(size_t i = 0; i < M.ld(); ++i)
+			M.at(i,j) = 0;
+}
+
+/** @brief Squared Frobenius norm of the (rectangular) M */
+template<class Mat>
+double normSquared(Mat& M){
+	double norm = 0;
+	for(size_t j = 0; j < nCols(M); ++j)
+		for(size_t i = 0; i < nRows(M); ++i)
+			norm += M.at(i,j)*M.at(i,j);
+	return norm;
+}
+
+/**
+ * @brief Calculates the selected columns of the inverse of A, all at once:
+ * LU*X = E for the n x k E of their unit vectors, with the tiled substitutions (substMLU0AU),
+ * refined with the tiled residue (multSub0AUIJ). \n
+ * O(n*n*k) per iteration, instead of O(n*n*n) for the whole inverse
+ * @param LU decomposition of A, padding zeroed
+ * @param P LU pivot permutation, A.sizeMem() elems
+ * @param cols indexes of the columns of A^-1 to calculate
+ * @param X return value, A.size() x cols.size(), column c is the column cols[c]
+ * @param iter_n refining iterations
+ */
+template<class AMatrix, class LUMatrix>
+void inverse_columns(AMatrix& A, LUMatrix& LU, varray<size_t>& P, vector<size_t>& cols,
+MatrixRectColMajor<double>& X, long iter_n){
+	size_t size = A.size(), k = cols.size();
+	MatrixRectColMajor<double> E(size, k), R(size, k), W(size, k), Z(size, k);
+	size_t ldVec = X.ld()/X.vecN();
+	// number of digits of iter_n, for pretty printing
+	long digits = (long)log10((double) max(iter_n, 1L)) + 1;
+	
+	zeroRect(E);
+	zeroRect(R);
+	for(size_t c = 0; c < k; ++c)
+		E.at(cols[c], c) = 1;
+	// find Z; LZ=PE, then X; UX=Z
+	substMLU0AU<Direction::Forwards, Diagonal::Unit, Permute::True>(LU, Z, E, P);
+	substMLU0AU<Direction::Backwards, Diagonal::Value, Permute::False>(LU, X, Z, P);
+	multSub0AUIJ(A, X, R, E); // R = E - A*X
+	cout<<"# iter "<< setfill('0') << setw(digits) << 0 <<": "<< sqrt(normSquared(R)) <<"\n";
+	for(long it = 1; it <= iter_n; ++it){
+		// W: residues of each variable of the columns
+		substMLU0AU<Direction::Forwards, Diagonal::Unit, Permute::True>(LU, Z, R, P);
+		substMLU0AU<Direction::Backwards, Diagonal::Value, Permute::False>(LU, W, Z, P);
+		for(size_t j = 0; j < k; ++j)
+			for(size_t iv = 0; iv < ldVec; ++iv) // vect loop, padding included
+				X.atv(iv,j).v += W.atv(iv,j).v;
+		multSub0AUIJ(A, X, R, E);
+		cout<<"# iter "<< setfill('0') << setw(digits) << it <<": "<< sqrt(normSquared(R)) <<"\n";
+	}
+}
+
+/**
+ * @brief Calculates only the diagonal of the inverse of A from its LU decomposition. \n
+ * A^-1 = U^-1 L^-1 P, so A^-1(j,j) = b.a where L a = P e_j and U^T b = e_j.
+ * Both unit vectors make the solves start at their nonzero row,
+ * O(n*n*n/3) in total instead of forming the whole inverse, O(n) memory
+ * @param LU decomposition of A
+ * @param P LU pivot permutation
+ * @param D return value, diagonal of A^-1
+ */
+template<class LUMatrix>
+void inverse_diagonal(LUMatrix& LU, varray<size_t>& P, varray<double>& D){
+	size_t size = LU.size();
+	size_t i, j, k;
+	varray<double> a(size), b(size);
+	varray<size_t> Pinv(size);
+	for(i = 0; i < size; ++i)
+		Pinv.at(P.at(i)) = i;
+	
+	for(j = 0; j < size; ++j){
+		// L a = P e_j, nonzero from row q
+		size_t q = Pinv.at(j);
+		a.at(q) = 1;
+		for(i = q+1; i < size; ++i){
+			a.at(i) = 0;
+			for(k = q; k < i; ++k)
+				a.at(i) -= LU.at(i,k) * a.at(k);
+		}
+		// U^T b = e_j, nonzero from row j, by rows of U
+		for(i = j; i < size; ++i)
+			b.at(i) = (i == j);
+		for(k = j; k < size; ++k){
+			b.at(k) /= LU.at(k,k);
+			for(i = k+1; i < size; ++i)
+				b.at(i) -= LU.at(k,i) * b.at(k);
+		}
+		D.at(j) = 0;
+		for(i = max(j, q); i < size; ++i)
+			D.at(j) += b.at(i) * a.at(i);
+	}
+}
+
+
+}
+#endif
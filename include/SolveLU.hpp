@@ -1,3 +1,6 @@
+#ifndef SOLVELU_H
+#define SOLVELU_H
+
 
 #include <iostream>
 #include <fstream>
@@ -11,6 +14,11 @@
 #include "Matrix.hpp"
 #include "GaussEl.hpp"
 #include "Subst.hpp"
+#include "MatrixView.hpp"
+#include "Ownership.hpp"
+#include "Workspace.hpp"
+#include "Expression.hpp"
+#include "Tuning.hpp"
 #include "Chronometer.hpp"
 
 namespace gm {
@@ -28,12 +36,11 @@ double lu_time = 0.0;
  * @param B Independent term matrix
  * @param P Permutation vector resulting of the pivoting
  * @param col Column of the matrix to be used as B
+ * @param Z work vector, resized to X.size() if it isn't
  */
-template<class LUMatrix, class XMatrix, class BMatrix>
-inline void solveLU(LUMatrix& LU, XMatrix& X, BMatrix& B, vector<long>& P, long col){
-	static
-	varray<double> Z(LU.sizeMem());
-	if(Z.size() != X.size()){ Z.alloc(X.size()); }
+template<class LUMatrix, class XMatrix, class BMatrix, class Elem>
+inline void solveLU(LUMatrix& LU, XMatrix& X, BMatrix& B, varray<size_t>& P, long col, GrowableArray<Elem>& Z){
+	Z.resize(X.size());
 	// find Z; LZ=B
 	subst<Direction::Forwards, Diagonal::Unit, Permute::True>(LU, Z, B, P, col);
 	// find X; Ux=Z
@@ -50,11 +57,9 @@ inline void solveLU(LUMatrix& LU, XMatrix& X, BMatrix& B, vector<long>& P, long
  */
 template<class LUMatrix, class IAMatrix, class IMatrix>
 inline void solveMLU(LUMatrix& LU, IAMatrix& X, IMatrix& B, vector<long>& P){
+	varray<typename ElemOf<LUMatrix>::type> Z(X.size());
 	for(long j = 0; j < X.size(); j++){
 		// for each X col solve SL to find the X col values
-		static
-		varray<double> Z(LU.sizeMem());
-		if(Z.size() != X.size()){ Z.alloc(X.size()); }
 		// find Z; LZ=B
 		subst<Direction::Forwards, Diagonal::Unit, Permute::True>(LU, Z, B, P, j);
 		// find X; Ux=Z
@@ -62,10 +67,12 @@ inline void solveMLU(LUMatrix& LU, IAMatrix& X, IMatrix& B, vector<long>& P){
 	}
 }
 
-template<class LUMatrix, class IAMatrix, class IMatrix>
-inline void solveMLU0(LUMatrix& LU, IAMatrix& X, IMatrix& B, varray<size_t>& P){
-	static
-	MatrixColMajor<double> Z(X.size());
+/**
+ * @brief Solves LU*X = B for all the columns of B with substMLU0AU
+ * @param Z work matrix, reallocated if it isn't X.size()
+ */
+template<class LUMatrix, class IAMatrix, class IMatrix, class Elem>
+inline void solveMLU0(LUMatrix& LU, IAMatrix& X, IMatrix& B, varray<size_t>& P, MatrixColMajor<Elem>& Z){
 	if(Z.size() != X.size()){ Z.alloc(X.size()); }
 	// find Z; LZ=B
 	substMLU0AU<Direction::Forwards, Diagonal::Unit, Permute::True>(LU, Z, B, P);
@@ -98,7 +105,7 @@ inline double residue(AMatrix& A, IAMatrix& IA, IMatrix& I){
 				I.at(i,j) += 1;
 			}
 			
-			err_norm += I.at(i,j)*I.at(i,j);
+			err_norm += absSq(I.at(i,j));
 		}
 	}
 	return sqrt(err_norm);
@@ -109,6 +116,7 @@ inline double residue(AMatrix& A, IAMatrix& IA, IMatrix& I){
  */
 template<class AMatrix, class IAMatrix, class IMatrix>
 inline double residue0(AMatrix& A, IAMatrix& IA, IMatrix& R){
+	typedef typename ElemOf<IMatrix>::type Elem;
 	size_t size = A.size();
 	size_t bi[5], bj[5], bk[5];
 	size_t bimax[5], bjmax[5], bkmax[5];
@@ -142,15 +150,15 @@ inline double residue0(AMatrix& A, IAMatrix& IA, IMatrix& R){
 	}
 	// Calculate norm error from R
 	double errNorm = 0;
-	vec<double> errNormV{0};
+	vec<Elem> errNormV{0};
 	for(size_t j = 0; j < size; ++j){
 		for(size_t iv = 0; iv < R.sizeVec(); ++iv) // vect loop
-			errNormV.v += R.atv(iv,j).v*R.atv(iv,j).v;
+			errNormV.v += conjv(R.atv(iv,j)).v*R.atv(iv,j).v;
 		for(size_t i = R.remStart(); i < R.size(); ++i) // vect remainder
-			errNormV[R.vecN()-1] += R.at(i,j)*R.at(i,j);
+			errNormV[R.vecN()-1] += absSq(R.at(i,j));
 	}
 	for(size_t v=0; v < R.vecN(); ++v) // vect result sum
-		errNorm += errNormV[v];
+		errNorm += real(errNormV[v]);
 	
 	return sqrt(errNorm);
 }
@@ -160,11 +168,12 @@ inline double residue0(AMatrix& A, IAMatrix& IA, IMatrix& R){
  */
 template<class AMatrix, class IAMatrix, class IMatrix>
 inline double residue0A(AMatrix& A, IAMatrix& IA, IMatrix& R){
+	typedef typename ElemOf<IMatrix>::type Elem;
 	size_t size = A.size();
 	size_t bi[5], bj[5], bk[5];
 	size_t bimax[5], bjmax[5], bkmax[5];
 	size_t bstep[5];
-	bstep[0] = B2L1;
+	bstep[0] = tileL1<Elem>();
 	bstep[1] = bstep[0]*3;
 	/* export GCC_ARGS=" -D L0=${32} -D L1M=${3}"*
 	bstep[0] = L0;
@@ -190,7 +199,7 @@ inline double residue0A(AMatrix& A, IAMatrix& IA, IMatrix& R){
 		size_t kmax = min(bk[0]+bstep[0], size);
 		for (i = bi[0]; i < imax; ++i)
 		for (j = bj[0]; j < jmax; ++j) {
-			vec<double> acc;
+			vec<Elem> acc;
 			vect(v) acc[v] = 0;
 			for (kv = bk[0]/vn; kv < kmax/vn; ++kv)
 				acc.v = acc.v - A.atv(i, kv).v * IA.atv(kv, j).v;
@@ -202,15 +211,15 @@ inline double residue0A(AMatrix& A, IAMatrix& IA, IMatrix& R){
 #undef vect
 	// Calculate norm error from R
 	double errNorm = 0;
-	vec<double> errNormV{0};
+	vec<Elem> errNormV{0};
 	for(size_t j = 0; j < size; ++j){
 		for(size_t iv = 0; iv < R.sizeVec(); ++iv) // vect loop
-			errNormV.v += R.atv(iv,j).v*R.atv(iv,j).v;
+			errNormV.v += conjv(R.atv(iv,j)).v*R.atv(iv,j).v;
 		for(size_t i = R.remStart(); i < R.size(); ++i) // vect remainder
-			errNormV[R.vecN()-1] += R.at(i,j)*R.at(i,j);
+			errNormV[R.vecN()-1] += absSq(R.at(i,j));
 	}
 	for(size_t v=0; v < R.vecN(); ++v) // vect result sum
-		errNorm += errNormV[v];
+		errNorm += real(errNormV[v]);
 	
 	return sqrt(errNorm);
 }
@@ -220,14 +229,15 @@ inline double residue0A(AMatrix& A, IAMatrix& IA, IMatrix& R){
  */
 template<class AMatrix, class IAMatrix, class IMatrix>
 inline double residue0AU(AMatrix& A, IAMatrix& IA, IMatrix& R){
+	typedef typename ElemOf<IMatrix>::type Elem;
 	size_t size = A.size();
 	size_t bi[5], bj[5], bk[5];
 	size_t bimax[5], bjmax[5], bkmax[5];
 	size_t bstep[5];
 	const size_t kunr = 8;
-	vec<double> acc;
+	vec<Elem> acc;
 	/**/
-	bstep[0] = B2L1;
+	bstep[0] = tileL1<Elem>();
 	bstep[1] = bstep[0]*3;
 	/* export GCC_ARGS=" -D L0=${24} -D L1M=${3}"*
 	bstep[0] = L0;
@@ -268,15 +278,15 @@ inline double residue0AU(AMatrix& A, IAMatrix& IA, IMatrix& R){
 #undef unr
 	// Calculate norm error from R
 	double errNorm = 0;
-	vec<double> errNormV{0};
+	vec<Elem> errNormV{0};
 	for(size_t j = 0; j < size; ++j){
 		for(size_t iv = 0; iv < R.sizeVec(); ++iv) // vect loop
-			errNormV.v += R.atv(iv,j).v*R.atv(iv,j).v;
+			errNormV.v += conjv(R.atv(iv,j)).v*R.atv(iv,j).v;
 		for(size_t i = R.remStart(); i < R.size(); ++i) // vect remainder
-			errNormV[R.vecN()-1] += R.at(i,j)*R.at(i,j);
+			errNormV[R.vecN()-1] += absSq(R.at(i,j));
 	}
 	for(size_t v=0; v < R.vecN(); ++v) // vect result sum
-		errNorm += errNormV[v];
+		errNorm += real(errNormV[v]);
 
 	return sqrt(errNorm);
 }
@@ -286,14 +296,15 @@ inline double residue0AU(AMatrix& A, IAMatrix& IA, IMatrix& R){
  */
 template<class AMatrix, class IAMatrix, class IMatrix>
 inline double residue0AUU(AMatrix& A, IAMatrix& IA, IMatrix& R){
+	typedef typename ElemOf<IMatrix>::type Elem;
 	size_t size = A.size();
 	size_t bi[5], bj[5], bk[5];
 	size_t bimax[5], bjmax[5], bkmax[5];
 	size_t bstep[5];
 	const size_t unr = 2;
-	vec<double> acc[unr*unr];
+	vec<Elem> acc[unr*unr];
 	/**/
-	bstep[0] = B2L1;
+	bstep[0] = tileL1<Elem>();
 	bstep[1] = bstep[0]*3;
 	/* export GCC_ARGS=" -D L0=${24} -D L1M=${3}"*
 	bstep[0] = L0;
@@ -337,71 +348,98 @@ inline double residue0AUU(AMatrix& A, IAMatrix& IA, IMatrix& R){
 #undef unr2
 	// Calculate norm error from R
 	double errNorm = 0;
-	vec<double> errNormV{0};
+	vec<Elem> errNormV{0};
 	for(size_t j = 0; j < size; ++j){
 		for(size_t iv = 0; iv < R.sizeVec(); ++iv) // vect loop
-			errNormV.v += R.atv(iv,j).v*R.atv(iv,j).v;
+			errNormV.v += conjv(R.atv(iv,j)).v*R.atv(iv,j).v;
 		for(size_t i = R.remStart(); i < R.size(); ++i) // vect remainder
-			errNormV[R.vecN()-1] += R.at(i,j)*R.at(i,j);
+			errNormV[R.vecN()-1] += absSq(R.at(i,j));
 	}
 	for(size_t v=0; v < R.vecN(); ++v) // vect result sum
-		errNorm += errNormV[v];
+		errNorm += real(errNormV[v]);
 
 	return sqrt(errNorm);
 }
+/**
+ * @brief Init of multSub0AUIJKernel keeping the values of C
+ */
+struct KeepC {};
+/**
+ * @brief C(i0:i1, j0:j1) = e(i0:i1, j0:j1), tile initialization of the kernels
+ */
+template<class CMatrix, class E>
+inline void initTile(CMatrix& C, const E& e, ssize_t i0, ssize_t i1, ssize_t j0, ssize_t j1){
+	for (ssize_t j = j0; j < j1; j++)
+	for (ssize_t i = i0; i < i1; i++)
+		C.at(i,j) = e.at(i,j);
+}
+template<class CMatrix>
+inline void initTile(CMatrix&, const KeepC&, ssize_t, ssize_t, ssize_t, ssize_t){}
 /**
- * @brief Given a matrix A and it's inverse, calculates residue into R. \n
+ * @brief C -= A*B, A row major, B column major, any of them may be rectangular
+ * (MatrixRect, MatrixView). \n
  * Tiling on L0, SSE, unrolling on i,j
+ * @param iunr, junr rows and columns of C unrolled
+ * @param init C = init - A*B: each tile of C is set from init (at(i,j), as the
+ * nodes of Expression.hpp) right before its first product; KeepC for C -= A*B
  */
-template<class AMatrix, class IAMatrix, class IMatrix>
-inline double residue0AUIJ(AMatrix& A, IAMatrix& IA, IMatrix& R){
-	ssize_t size = A.size();
+template<ssize_t iunr, ssize_t junr, class AMatrix, class BMatrix, class CMatrix, class Init>
+inline void multSub0AUIJKernel(AMatrix& A, BMatrix& B, CMatrix& C, const Init& init){
+	typedef typename ElemOf<CMatrix>::type Elem;
+	ssize_t rows = nRows(C), cols = nCols(C), inner = nCols(A);
 	ssize_t bi[5], bj[5], bk[5];
 	//size_t bimax[5], bjmax[5], bkmax[5];
 	ssize_t bstep[5];
+	vec<Elem> acc[iunr*junr];
+	const vec<Elem>* a[iunr]; // A rows and B columns of the run being multiplied
+	const vec<Elem>* b[junr];
+	size_t r, run;
 	/**/
-	const ssize_t iunr = 2;
-	const ssize_t junr = 4;
-	/* export GCC_ARGS=" -D IUNRLL=${2} -D JUNRLL=${4}"* const size_t iunr = IUNRLL; const size_t junr = JUNRLL;/**/
-	vec<double> acc[iunr*junr];
-	/**/
-	bstep[0] = B2L1;
+	bstep[0] = tuning().residue.tileOf<Elem>();
+	bstep[1] = tileL2<Elem>(bstep[0]);
+	bstep[2] = tileL3<Elem>(bstep[1]);
 	/* export GCC_ARGS=" -D L0=${24} -D L1M=${3}"* bstep[0] = L0; bstep[1] = bstep[0]*L1M;/**/
 	ssize_t i, j, k, kv;
-	for(j = 0; j < size; ++j){
-		for(i = 0; i < j; ++i)
-			R.at(i,j) = 0;
-		R.at(j,j) = 1;
-		for(i = j+1; i < size; ++i)
-			R.at(i,j) = 0;
-	}
-	// Multiply A*IA and subtract from R
-	ssize_t vn = R.vecN(); // number of elements on the register (vectorization)
+	// Multiply A*B and subtract from C
+	ssize_t vn = C.vecN(); // number of elements on the register (vectorization)
 	
 #define vect(v) for(ssize_t v=0; v < vn; ++v) // ease vectorization
 #define unrll(u,step) for(size_t u = 0; u < step; ++u) // ease unrolling
 #define unr(iu,iunr,ju,junr) unrll(iu,iunr) unrll(ju,junr) // unroll 2 dimensions
 	
-	for (bi[0] = 0; bi[0] < size; bi[0] += bstep[0]) // L1 tiling
-	for (bj[0] = 0; bj[0] < size; bj[0] += bstep[0])
-	for (bk[0] = 0; bk[0] < size; bk[0] += bstep[0]){
-		ssize_t imax = min(bi[0]+bstep[0], size); // setting tile limits
-		ssize_t jmax = min(bj[0]+bstep[0], size);
-		ssize_t kmax = min(bk[0]+bstep[0], size);
+	for (bi[2] = 0; bi[2] < rows; bi[2] += bstep[2]) // L3 tiling
+	for (bj[2] = 0; bj[2] < cols; bj[2] += bstep[2])
+	for (bk[2] = 0; bk[2] < inner; bk[2] += bstep[2])
+	for (bi[1] = bi[2]; bi[1] < min(bi[2]+bstep[2], rows); bi[1] += bstep[1]) // L2 tiling
+	for (bj[1] = bj[2]; bj[1] < min(bj[2]+bstep[2], cols); bj[1] += bstep[1])
+	for (bk[1] = bk[2]; bk[1] < min(bk[2]+bstep[2], inner); bk[1] += bstep[1])
+	for (bi[0] = bi[1]; bi[0] < min(bi[1]+bstep[1], rows); bi[0] += bstep[0]) // L1 tiling
+	for (bj[0] = bj[1]; bj[0] < min(bj[1]+bstep[1], cols); bj[0] += bstep[0])
+	for (bk[0] = bk[1]; bk[0] < min(bk[1]+bstep[1], inner); bk[0] += bstep[0]){
+		ssize_t imax = min(bi[0]+bstep[0], rows); // setting tile limits
+		ssize_t jmax = min(bj[0]+bstep[0], cols);
+		ssize_t kmax = min(bk[0]+bstep[0], inner);
+		if(bk[0] == 0) // C tile not yet used, in cache for the products
+			initTile(C, init, bi[0], imax, bj[0], jmax);
 		for (i = bi[0]; i < imax -(iunr-1); i += iunr) { // i unroll
 			for (j = bj[0]; j < jmax -(junr-1); j += junr) { // j unroll
-// Multiply current tile: i,j = A krow * IA kcol
+// Multiply current tile: i,j = A krow * B kcol
 // For (i,j): from i to i+iunr; from j to j+junr
 #define kloop(iunr, junr)	\
-				unr(iu,iunr,ju,junr) vect(v) acc[iu*junr + ju][v] = 0;	\
-				for (kv = bk[0]/vn; kv < kmax/vn; ++kv) /*vectorized loop*/	\
-					unr(iu,iunr,ju,junr)	\
-					acc[iu*junr+ju].v += A.atv(i+iu, kv).v * IA.atv(kv, j+ju).v;	\
+				unr(iu,iunr,ju,junr) acc[iu*junr + ju] = vec<Elem>{};	\
+				for (kv = bk[0]/vn; kv < kmax/vn; kv += run) { /*vectorized loop, by contiguous runs*/	\
+					run = min((size_t)(kmax/vn - kv), min(contiguousFrom(A, kv*vn), contiguousFrom(B, kv*vn))/vn);	\
+					unrll(iu,iunr) a[iu] = &A.atv(i+iu, kv);	\
+					unrll(ju,junr) b[ju] = &B.atv(kv, j+ju);	\
+					for (r = 0; r < run; ++r)	\
+						unr(iu,iunr,ju,junr)	\
+						acc[iu*junr+ju].v += a[iu][r].v * b[ju][r].v;	\
+				}	\
 				for(k = kv*vn; k < kmax; ++k) /*vect remainder*/	\
 					unr(iu,iunr,ju,junr)	\
-					R.at(i+iu, j+ju) -= A.at(i+iu, k) * IA.at(k, j+ju);	\
+					C.at(i+iu, j+ju) -= A.at(i+iu, k) * B.at(k, j+ju);	\
 				unr(iu,iunr,ju,junr) /*vect result sum*/	\
-				vect(v) R.at(i+iu, j+ju) -= acc[iu*junr+ju][v];
+				vect(v) C.at(i+iu, j+ju) -= acc[iu*junr+ju][v];
 // end define
 				kloop(iunr, junr)
 			}
@@ -420,51 +458,320 @@ inline double residue0AUIJ(AMatrix& A, IAMatrix& IA, IMatrix& R){
 	}
 #undef unrll
 #undef kloop
+#undef unr
+#undef vect
+}
+/**
+ * @brief multSub0AUIJKernel with the unrolling of tuning(), C = init - A*B
+ */
+template<class AMatrix, class BMatrix, class CMatrix, class Init>
+inline void multSub0AUIJ(AMatrix& A, BMatrix& B, CMatrix& C, const Init& init){
+	typedef typename ElemOf<CMatrix>::type Elem;
+	const KernelTuning& tuned = tuning().residue;
+#define call(iunr, junr) multSub0AUIJKernel<iunr, junr>(A, B, C, init)
+	unrolled(call, Elem, tuned.iunr, tuned.junr)
+#undef call
+}
+/**
+ * @brief C -= A*B, multSub0AUIJKernel with the unrolling of tuning()
+ */
+template<class AMatrix, class BMatrix, class CMatrix>
+inline void multSub0AUIJ(AMatrix& A, BMatrix& B, CMatrix& C){
+	multSub0AUIJ(A, B, C, KeepC());
+}
+/**
+ * @brief Given a matrix A and it's inverse, calculates residue into R. \n
+ * Tiling on L0, SSE, unrolling on i,j
+ * @param iunr, junr rows and columns of R unrolled
+ */
+template<ssize_t iunr, ssize_t junr, class AMatrix, class IAMatrix, class IMatrix>
+inline double residue0AUIJKernel(AMatrix& A, IAMatrix& IA, IMatrix& R){
+	typedef typename ElemOf<IMatrix>::type Elem;
+	ssize_t size = A.size();
+	ssize_t i, j;
+	// identity written per tile by the multiplication
+	multSub0AUIJKernel<iunr, junr>(A, IA, R, IdentityExpr<Elem>());
+	ssize_t vn = R.vecN(); // number of elements on the register (vectorization)
+#define vect(v) for(ssize_t v=0; v < vn; ++v) // ease vectorization
 	// Calculate norm error from R
 	ssize_t iv;
 	double errNorm = 0;
-	vec<double> errNormV{0};
+	vec<Elem> errNormV{0};
 	for(j = 0; j < size; ++j){
 		for(iv = 0; iv < R.sizeVec(); ++iv) // vect loop
-			errNormV.v += R.atv(iv,j).v*R.atv(iv,j).v;
+			errNormV.v += conjv(R.atv(iv,j)).v*R.atv(iv,j).v;
 		for(i = R.remStart(); i < R.size(); ++i) // vect remainder
-			errNormV[R.vecN()-1] += R.at(i,j)*R.at(i,j);
+			errNormV[R.vecN()-1] += absSq(R.at(i,j));
+	}
+	vect(v) errNorm += real(errNormV[v]); // vect result sum
+	
+	return sqrt(errNorm);
+#undef vect
+}
+/**
+ * @brief residue0AUIJKernel compiled for the instruction set of the host, see dispatch()
+ */
+template<ssize_t iunr, ssize_t junr, class AMatrix, class IAMatrix, class IMatrix>
+inline double residue0AUIJDispatch(AMatrix& A, IAMatrix& IA, IMatrix& R){
+	double errNorm;
+	dispatch([&]{ errNorm = residue0AUIJKernel<iunr, junr>(A, IA, R); });
+	return errNorm;
+}
+/**
+ * @brief residue0AUIJDispatch with the unrolling of tuning()
+ */
+template<class AMatrix, class IAMatrix, class IMatrix>
+inline double residue0AUIJ(AMatrix& A, IAMatrix& IA, IMatrix& R){
+	typedef typename ElemOf<IMatrix>::type Elem;
+	const KernelTuning& tuned = tuning().residue;
+	double errNorm;
+#define call(iunr, junr) errNorm = residue0AUIJDispatch<iunr, junr>(A, IA, R)
+	unrolled(call, Elem, tuned.iunr, tuned.junr)
+#undef call
+	return errNorm;
+}
+/**
+ * @brief IA += W, then given A and IA calculates residue into R. \n
+ * Same multiplication as residue0AUIJ, fused with the sum and the norm:
+ * each IA column tile gets W added right before it is used,
+ * the norm is accumulated while the finished R tile is still in cache.
+ * Saves two n*n memory sweeps per refining iteration
+ * @param W correction to be added to IA
+ * @param iunr, junr rows and columns of R unrolled
+ * @return Norm of the residue
+ */
+template<ssize_t iunr, ssize_t junr, class AMatrix, class IAMatrix, class WMatrix, class IMatrix>
+inline double residue0AUIJFusedKernel(AMatrix& A, IAMatrix& IA, WMatrix& W, IMatrix& R){
+	typedef typename ElemOf<IMatrix>::type Elem;
+	ssize_t size = A.size();
+	ssize_t bi[5], bj[5], bk[5];
+	ssize_t bstep[5];
+	vec<Elem> acc[iunr*junr];
+	const vec<Elem>* a[iunr]; // A rows and IA columns of the run being multiplied
+	const vec<Elem>* b[junr];
+	size_t r, run;
+	bstep[0] = tuning().residue.tileOf<Elem>();
+	bstep[1] = tileL2<Elem>(bstep[0]);
+	bstep[2] = tileL3<Elem>(bstep[1]);
+	ssize_t i, j, k, kv, iv;
+	ssize_t vn = R.vecN(); // number of elements on the register (vectorization)
+	double errNorm = 0;
+	vec<Elem> errNormV{0};
+	
+#define vect(v) for(ssize_t v=0; v < vn; ++v) // ease vectorization
+#define unrll(u,step) for(size_t u = 0; u < step; ++u) // ease unrolling
+#define unr(iu,iunr,ju,junr) unrll(iu,iunr) unrll(ju,junr) // unroll 2 dimensions
+	
+	// IA column tiles outermost; an R tile is finished in the last k tile of L2
+	for (bj[2] = 0; bj[2] < size; bj[2] += bstep[2]) // L3 tiling
+	for (bi[2] = 0; bi[2] < size; bi[2] += bstep[2])
+	for (bk[2] = 0; bk[2] < size; bk[2] += bstep[2])
+	for (bj[1] = bj[2]; bj[1] < min(bj[2]+bstep[2], size); bj[1] += bstep[1]) // L2 tiling
+	for (bi[1] = bi[2]; bi[1] < min(bi[2]+bstep[2], size); bi[1] += bstep[1])
+	for (bk[1] = bk[2]; bk[1] < min(bk[2]+bstep[2], size); bk[1] += bstep[1])
+	for (bj[0] = bj[1]; bj[0] < min(bj[1]+bstep[1], size); bj[0] += bstep[0]) { // L1 tiling
+		ssize_t jmax = min(bj[0]+bstep[0], size);
+		// adjust this IA column tile before it is first used
+		if(bi[1] == 0 && bk[1] == 0)
+		for(j = bj[0]; j < jmax; ++j){
+			for(iv = 0; iv < IA.sizeVec(); ++iv) // vect loop
+				IA.atv(iv,j).v += W.atv(iv,j).v;
+			for(i = IA.remStart(); i < size; ++i) // vect remainder
+				IA.at(i,j) += W.at(i,j);
+		}
+		for (bi[0] = bi[1]; bi[0] < min(bi[1]+bstep[1], size); bi[0] += bstep[0]) {
+			ssize_t imax = min(bi[0]+bstep[0], size);
+			// set R tile to identity before its first k tile
+			if(bk[1] == 0)
+			for(j = bj[0]; j < jmax; ++j)
+				for(i = bi[0]; i < imax; ++i)
+					R.at(i,j) = (i == j);
+			// Multiply A*IA and subtract from R tile
+			for (bk[0] = bk[1]; bk[0] < min(bk[1]+bstep[1], size); bk[0] += bstep[0]) {
+				ssize_t kmax = min(bk[0]+bstep[0], size);
+				for (i = bi[0]; i < imax -(iunr-1); i += iunr) { // i unroll
+					for (j = bj[0]; j < jmax -(junr-1); j += junr) { // j unroll
+// Multiply current tile: i,j = A krow * IA kcol
+// For (i,j): from i to i+iunr; from j to j+junr
+#define kloop(iunr, junr)	\
+						unr(iu,iunr,ju,junr) acc[iu*junr + ju] = vec<Elem>{};	\
+						for (kv = bk[0]/vn; kv < kmax/vn; kv += run) { /*vectorized loop, by contiguous runs*/	\
+							run = min((size_t)(kmax/vn - kv), min(contiguousFrom(A, kv*vn), contiguousFrom(IA, kv*vn))/vn);	\
+							unrll(iu,iunr) a[iu] = &A.atv(i+iu, kv);	\
+							unrll(ju,junr) b[ju] = &IA.atv(kv, j+ju);	\
+							for (r = 0; r < run; ++r)	\
+								unr(iu,iunr,ju,junr)	\
+								acc[iu*junr+ju].v += a[iu][r].v * b[ju][r].v;	\
+						}	\
+						for(k = kv*vn; k < kmax; ++k) /*vect remainder*/	\
+							unr(iu,iunr,ju,junr)	\
+							R.at(i+iu, j+ju) -= A.at(i+iu, k) * IA.at(k, j+ju);	\
+						unr(iu,iunr,ju,junr) /*vect result sum*/	\
+						vect(v) R.at(i+iu, j+ju) -= acc[iu*junr+ju][v];
+// end define
+						kloop(iunr, junr)
+					}
+					for(j = j; j < jmax; ++j){ // j unroll reminder
+						kloop(iunr,1)
+					}
+				}
+				for (i = i; i < imax; ++i) { // i unroll remainder
+					for (j = bj[0]; j < jmax -(junr-1); j += junr) { // j unroll
+						kloop(1,junr)
+					}
+					for (j = j; j < jmax; ++j) { // j unroll reminder
+						kloop(1,1)
+					}
+				}
+			}
+			// R tile is final after its last k tile, add it to the norm
+			if(bk[1]+bstep[1] >= size)
+			for(j = bj[0]; j < jmax; ++j){
+				for(iv = bi[0]/vn; iv < imax/vn; ++iv) // vect loop
+					errNormV.v += conjv(R.atv(iv,j)).v*R.atv(iv,j).v;
+				for(i = iv*vn; i < imax; ++i) // vect remainder
+					errNormV[vn-1] += absSq(R.at(i,j));
+			}
+		}
 	}
-	vect(v) errNorm += errNormV[v]; // vect result sum
+#undef unrll
+#undef unr
+#undef kloop
+	vect(v) errNorm += real(errNormV[v]); // vect result sum
 	
 	return sqrt(errNorm);
 #undef vect
 }
+/**
+ * @brief residue0AUIJFusedKernel compiled for the instruction set of the host, see dispatch()
+ */
+template<ssize_t iunr, ssize_t junr, class AMatrix, class IAMatrix, class WMatrix, class IMatrix>
+inline double residue0AUIJFusedDispatch(AMatrix& A, IAMatrix& IA, WMatrix& W, IMatrix& R){
+	double errNorm;
+	dispatch([&]{ errNorm = residue0AUIJFusedKernel<iunr, junr>(A, IA, W, R); });
+	return errNorm;
+}
+/**
+ * @brief residue0AUIJFusedDispatch with the unrolling of tuning()
+ */
+template<class AMatrix, class IAMatrix, class WMatrix, class IMatrix>
+inline double residue0AUIJFused(AMatrix& A, IAMatrix& IA, WMatrix& W, IMatrix& R){
+	typedef typename ElemOf<IMatrix>::type Elem;
+	const KernelTuning& tuned = tuning().residue;
+	double errNorm;
+#define call(iunr, junr) errNorm = residue0AUIJFusedDispatch<iunr, junr>(A, IA, W, R)
+	unrolled(call, Elem, tuned.iunr, tuned.junr)
+#undef call
+	return errNorm;
+}
+/**
+ * @brief Z = X - A*Y, dot on each A row. Overloaded for matrices given by a generator
+ * @param A row major
+ */
+template<class AMatrix, class Elem>
+inline void subMultVec(AMatrix& A, varray<Elem>& X, varray<Elem>& Y, varray<Elem>& Z){
+	ssize_t size = A.size();
+	ssize_t i, j, jv;
+	ssize_t vn = Y.vecN();
+	
+#define vect(v) for(ssize_t v=0; v < vn; ++v) // ease vectorization
+	
+	for(i = 0; i < size; ++i){
+		vec<Elem> acc{0};
+		for(jv = 0; jv < Y.sizeVec(); ++jv) // vect loop
+			acc.v += A.atv(i,jv).v * Y.atv(jv).v;
+		Z.at(i) = X.at(i);
+		for(j = Y.remStart(); j < size; ++j) // vect remainder
+			Z.at(i) -= A.at(i,j) * Y.at(j);
+		vect(v) Z.at(i) -= acc[v]; // vect result sum
+	}
+#undef vect
+}
+/**
+ * @brief Estimates the norm of R = I - A*(IA+W) without forming R or IA+W, O(n*n) per probe. \n
+ * For x with random +-1 entries E(|R*x|^2) = |R|^2,
+ * so the mean of the probes estimates the same norm residue0AUIJ returns
+ * @param W correction pending on IA, NULL for none
+ * @param probes number of random vectors used
+ * @param X, Y, Z work vectors, A.size() elems
+ * @return Estimated norm of the residue
+ */
+template<class AMatrix, class IAMatrix, class WMatrix, class Elem>
+inline double residueEstimate(AMatrix& A, IAMatrix& IA, WMatrix* W, size_t probes,
+varray<Elem>& X, varray<Elem>& Y, varray<Elem>& Z){
+	ssize_t size = A.size();
+	ssize_t i, j, iv;
+	ssize_t vn = Y.vecN();
+	double errNorm = 0;
+	
+#define vect(v) for(ssize_t v=0; v < vn; ++v) // ease vectorization
+	
+	for(size_t p = 0; p < probes; ++p){
+		for(i = 0; i < size; ++i)
+			X.at(i) = (rand() & 1) ? 1.0 : -1.0;
+		// Y = (IA+W)*X, axpy on each IA and W column
+		for(i = 0; i < size; ++i)
+			Y.at(i) = 0;
+		for(j = 0; j < size; ++j){
+			vec<Elem> x;
+			vect(v) x[v] = X.at(j);
+			for(iv = 0; iv < Y.sizeVec(); ++iv) // vect loop
+				Y.atv(iv).v += IA.atv(iv,j).v * x.v;
+			for(i = Y.remStart(); i < size; ++i) // vect remainder
+				Y.at(i) += IA.at(i,j) * X.at(j);
+			if(W == NULL)
+				continue;
+			for(iv = 0; iv < Y.sizeVec(); ++iv) // vect loop
+				Y.atv(iv).v += W->atv(iv,j).v * x.v;
+			for(i = Y.remStart(); i < size; ++i) // vect remainder
+				Y.at(i) += W->at(i,j) * X.at(j);
+		}
+		subMultVec(A, X, Y, Z);
+		for(i = 0; i < size; ++i)
+			errNorm += absSq(Z.at(i));
+	}
+#undef vect
+	
+	return sqrt(errNorm/probes);
+}
+/**
+ * @brief Estimates the norm of R = I - A*IA without forming R, see residueEstimate above
+ */
+template<class AMatrix, class IAMatrix, class Elem>
+inline double residueEstimate(AMatrix& A, IAMatrix& IA, size_t probes,
+varray<Elem>& X, varray<Elem>& Y, varray<Elem>& Z){
+	return residueEstimate(A, IA, (IAMatrix*)NULL, probes, X, Y, Z);
+}
 /**
  * @brief Calculates inverse of A into IA
  * @param LU decomposition of A
  * @param IA return value, no init needed
  * @param P LU pivot permutation
  * @param iter_n
+ * @param ws work matrices W, R and Z, sized to A.size()
+ * @param report print the residues and add to the global timers; off, nothing global
+ * is touched and many can run at once in different threads
+ * @return norm of the residue of IA
  */
-template<class AMatrix, class LUMatrix, class IAMatrix>
-void inverse_refining(AMatrix& A, LUMatrix& LU, IAMatrix& IA, varray<size_t>& P, long iter_n){
+template<class AMatrix, class LUMatrix, class IAMatrix, class Elem>
+double inverse_refining(AMatrix& A, LUMatrix& LU, IAMatrix& IA, varray<size_t>& P, long iter_n,
+InverseWorkspace<Elem>& ws, bool report = true){
 	long i=0;
 	// number of digits of iter_n, for pretty printing
-	long digits = (long)log10((double) iter_n) + 1;
+	long digits = (long)log10((double) max(iter_n, 1L)) + 1;
 	double c_residue;
 	//double l_residue;
-	size_t size = A.size();
 	// Optm: iterating line by line
-	MatrixColMajor<double> W(A.size()), R(A.size());
+	MatrixColMajor<Elem>& W = ws.W();
+	MatrixColMajor<Elem>& R = ws.R();
+	MatrixColMajor<Elem>& Z = ws.Z();
 	
-	for(size_t j = 0; j < size; ++j){
-		for(size_t i = 0; i < j; ++i)
-			R.at(i,j) = 0;
-		R.at(j,j) = 1;
-		for(size_t i = j+1; i < size; ++i)
-			R.at(i,j) = 0;
-	}
+	assign(R, IdentityExpr<Elem>());
 
 	//LIKWID_MARKER_START("INV");
 	
 	//solveMLU(LU, IA, R, P);
-	solveMLU0(LU, IA, R, P);
+	solveMLU0(LU, IA, R, P, Z);
 	
 	//LIKWID_MARKER_STOP("INV");
 	//LIKWID_MARKER_START("RES");
@@ -473,51 +780,195 @@ void inverse_refining(AMatrix& A, LUMatrix& LU, IAMatrix& IA, varray<size_t>& P,
 	
 	//LIKWID_MARKER_STOP("RES");
 	
-	cout<<"# iter "<< setfill('0') << setw(digits) << i <<": "<< c_residue <<"\n";
+	if(report)
+		cout<<"# iter "<< setfill('0') << setw(digits) << i <<": "<< c_residue <<"\n";
 	while(i < iter_n){
 		// (abs(l_residue - c_residue)/c_residue > EPSILON) && (l_residue > c_residue)
 		// relative approximate error
 		i += 1;
 		// R: residue of IA
 
-		timer.start();
+		if(report)
+			timer.start();
 		//LIKWID_MARKER_START("INV");
 		
 		//solveMLU(LU, W, R, P);
-		solveMLU0(LU, W, R, P);
+		solveMLU0(LU, W, R, P, Z);
 		
 		//LIKWID_MARKER_STOP("INV");
 		// W: residues of each variable of IA
-		// adjust IA with found errors
-		//LIKWID_MARKER_START("SUM");
+		if(report){
+			total_time_iter += timer.tickAverage();
+			timer.start();
+		}
 		
-		//add(IA, W);
-#define unrll(u,step) for(ssize_t u = 0; u < step; ++u) // ease unrolling
-		ssize_t i, j, junr = 8, size = IA.size();
-		for(j=0; j < size -(junr-1); j += junr)
-			for(i=0; i < size; ++i)
-				unrll(ju,junr)
-				IA.at(i,j+ju) += W.at(i,j+ju);
-		for(j = j; j < size; ++j)
-			for(i=0; i < size; ++i)
-				IA.at(i,j) += W.at(i,j);
-#undef unrll
+		//l_residue = c_residue;
+		//LIKWID_MARKER_START("RES");
+		
+		// adjust IA with found errors, and calculate its residue in the same pass
+		c_residue = residue0AUIJFused(A, IA, W, R);
 		
-		//LIKWID_MARKER_STOP("SUM");
+		//LIKWID_MARKER_STOP("RES");
+		if(report){
+			total_time_residue += timer.tick();
+			cout<<"# iter "<< setfill('0') << setw(digits) << i <<": "<< c_residue <<"\n";
+		}
+	}
+	return c_residue;
+}
+template<class AMatrix, class LUMatrix, class IAMatrix>
+double inverse_refining(AMatrix& A, LUMatrix& LU, IAMatrix& IA, varray<size_t>& P, long iter_n){
+	InverseWorkspace<typename ElemOf<AMatrix>::type> ws;
+	ws.reserve(A.size());
+	return inverse_refining(A, LU, IA, P, iter_n, ws);
+}
+
+/**
+ * @brief Calculates inverse of A into IA, like inverse_refining,
+ * but monitors convergence with residueEstimate. \n
+ * Each correction W is estimated before it is applied. IA += W and the next R
+ * come from one residue0AUIJFused pass: R for the next correction or, when the
+ * estimate says the loop is done, the exact norm that confirms it; near convergence
+ * the rounding of the estimate is larger than the residue, only the exact norm stops
+ * @param probes number of random vectors per estimate
+ * @param tol residue norm considered converged,
+ * iterating also stops when the residue stops decreasing
+ * @param ws work matrices W, R, Z and vectors 0 to 2, sized to A.size()
+ * @return number of iterations done
+ */
+template<class AMatrix, class LUMatrix, class IAMatrix, class Elem>
+long inverse_refining_estimate(AMatrix& A, LUMatrix& LU, IAMatrix& IA, varray<size_t>& P, long iter_n,
+size_t probes, double tol, InverseWorkspace<Elem>& ws){
+	// residue is considered stalled if it isn't at least halved each iteration
+	const double stall = 0.5;
+	long i=0;
+	// number of digits of iter_n, for pretty printing
+	long digits = (long)log10((double) max(iter_n, 1L)) + 1;
+	double c_residue, l_residue;
+	MatrixColMajor<Elem>& W = ws.W();
+	MatrixColMajor<Elem>& R = ws.R();
+	MatrixColMajor<Elem>& T = ws.Z();
+	varray<Elem>& X = ws.v(0);
+	varray<Elem>& Y = ws.v(1);
+	varray<Elem>& Z = ws.v(2);
+	
+	assign(R, IdentityExpr<Elem>());
+	solveMLU0(LU, IA, R, P, T);
+	c_residue = residue0AUIJ(A, IA, R);
+	
+	cout<<"# iter "<< setfill('0') << setw(digits) << i <<": "<< c_residue <<"\n";
+	while(i < iter_n && c_residue > tol){
+		i += 1;
+		l_residue = c_residue;
+		// R: residue of IA
+		timer.start();
+		solveMLU0(LU, W, R, P, T);
+		// W: residues of each variable of IA
 		total_time_iter += timer.tickAverage();
 		
-		//l_residue = c_residue;
 		timer.start();
-		//LIKWID_MARKER_START("RES");
+		double estimate = residueEstimate(A, IA, &W, probes, X, Y, Z);
+		bool done = i == iter_n || estimate <= tol || estimate > stall*l_residue;
+		// adjust IA and calculate its residue in the same pass
+		c_residue = residue0AUIJFused(A, IA, W, R);
+		total_time_residue += timer.tick();
 		
-		c_residue = residue0AUIJ(A, IA, R);
+		cout<<"# iter "<< setfill('0') << setw(digits) << i <<": "<< c_residue;
+		if(done)
+			cout<<" (estimado "<< estimate <<")";
+		cout<<"\n";
+		if(c_residue > stall*l_residue)
+			break;
+	}
+	return i;
+}
+template<class AMatrix, class LUMatrix, class IAMatrix>
+long inverse_refining_estimate(AMatrix& A, LUMatrix& LU, IAMatrix& IA, varray<size_t>& P, long iter_n,
+size_t probes, double tol){
+	InverseWorkspace<typename ElemOf<AMatrix>::type> ws;
+	ws.reserve(A.size());
+	return inverse_refining_estimate(A, LU, IA, P, iter_n, probes, tol, ws);
+}
+
+/**
+ * @brief Refines the inverse IA of A with the Newton-Schulz iteration
+ * IA = IA*(2I - A*IA) = IA + IA*R. \n
+ * Only matrix multiplications (multSub0AUIJ) per iteration, no substitutions;
+ * converges quadratically when the residue of the given IA is below 1
+ * @param IA approximate inverse of A, refined in place
+ * @param iter_n maximum iterations, stops early once the residue stops decreasing
+ * @return number of iterations done; -1 if the residue of IA is too large for the
+ * iteration to converge, IA is then left untouched
+ * @param ws work matrices X and R, sized to A.size()
+ */
+template<class AMatrix, class IAMatrix, class Elem>
+long refine_newton_schulz(AMatrix& A, IAMatrix& IA, long iter_n, InverseWorkspace<Elem>& ws){
+	long i=0;
+	// number of digits of iter_n, for pretty printing
+	long digits = (long)log10((double) max(iter_n, 1L)) + 1;
+	double c_residue, l_residue;
+	// -IA in row major, left operand of the multiplication
+	Matrix<Elem>& X = ws.X();
+	MatrixColMajor<Elem>& R = ws.R();
+	
+	c_residue = residue0AUIJ(A, IA, R);
+	
+	cout<<"# iter "<< setfill('0') << setw(digits) << i <<": "<< c_residue <<"\n";
+	if(c_residue >= 1)
+		return -1;
+	while(i < iter_n){
+		i += 1;
+		l_residue = c_residue;
 		
-		//LIKWID_MARKER_STOP("RES");
+		timer.start();
+		assign(X, -IA);
+		// IA = IA + IA*R
+		multSub0AUIJ(X, R, IA);
+		total_time_iter += timer.tickAverage();
+		
+		timer.start();
+		c_residue = residue0AUIJ(A, IA, R);
 		total_time_residue += timer.tick();
 		
 		cout<<"# iter "<< setfill('0') << setw(digits) << i <<": "<< c_residue <<"\n";
+		if(c_residue >= l_residue)
+			break; // reached rounding level
 	}
+	return i;
+}
+template<class AMatrix, class IAMatrix>
+long refine_newton_schulz(AMatrix& A, IAMatrix& IA, long iter_n){
+	InverseWorkspace<typename ElemOf<AMatrix>::type> ws;
+	ws.reserve(A.size());
+	return refine_newton_schulz(A, IA, iter_n, ws);
+}
+/**
+ * @brief Calculates inverse of A into IA, seeded with the inverse from the LU
+ * and refined with refine_newton_schulz
+ * @param LU decomposition of A
+ * @param IA return value, no init needed
+ * @param P LU pivot permutation
+ * @param iter_n maximum iterations
+ * @return number of iterations done; -1 if the seed residue is too large for the
+ * iteration to converge, IA then holds the unrefined inverse
+ * @param ws work matrices X, R and Z, sized to A.size()
+ */
+template<class AMatrix, class LUMatrix, class IAMatrix, class Elem>
+long inverse_newton_schulz(AMatrix& A, LUMatrix& LU, IAMatrix& IA, varray<size_t>& P, long iter_n,
+InverseWorkspace<Elem>& ws){
+	// R holds the identity until the first residue
+	MatrixColMajor<Elem>& I = ws.R();
+	assign(I, IdentityExpr<Elem>());
+	solveMLU0(LU, IA, I, P, ws.Z());
+	return refine_newton_schulz(A, IA, iter_n, ws);
+}
+template<class AMatrix, class LUMatrix, class IAMatrix>
+long inverse_newton_schulz(AMatrix& A, LUMatrix& LU, IAMatrix& IA, varray<size_t>& P, long iter_n){
+	InverseWorkspace<typename ElemOf<AMatrix>::type> ws;
+	ws.reserve(A.size());
+	return inverse_newton_schulz(A, LU, IA, P, iter_n, ws);
 }
 
 
-}
\ No newline at end of file
+}
+#endif
\ No newline at end of file
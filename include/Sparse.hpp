@@ -0,0 +1,345 @@
+#ifndef SPARSE_H
+#define SPARSE_H
+
+#include <vector>
+#include <queue>
+#include <algorithm>
+#include <cmath>
+
+#include "Matrix.hpp"
+#include "Condition.hpp"
+
+namespace gm {
+using namespace std;
+
+/**
+ * @brief Square sparse matrix in compressed sparse column (CSC) storage:
+ * rows and values of column j are in rowInd, val from colPtr[j] to colPtr[j+1]-1.
+ * Memory is O(n + nnz)
+ */
+struct SparseMatrix
+{
+	size_t n;
+	vector<size_t> colPtr, rowInd;
+	vector<double> val;
+
+	SparseMatrix(size_t n = 0) : n(n), colPtr(n+1, 0) {}
+	size_t size() const { return n; }
+	size_t nnz() const { return rowInd.size(); }
+
+	/**
+	 * @brief Builds the matrix from (I[k], J[k], V[k]) triplets, repeated ones are summed
+	 */
+	void fromTriplets(size_t size, vector<size_t>& I, vector<size_t>& J, vector<double>& V){
+		n = size;
+		colPtr.assign(n+1, 0);
+		for(size_t k = 0; k < J.size(); ++k)
+			colPtr[J[k]+1]++;
+		for(size_t j = 0; j < n; ++j)
+			colPtr[j+1] += colPtr[j];
+		vector<size_t> next(colPtr.begin(), colPtr.end()-1);
+		rowInd.assign(J.size(), 0);
+		val.assign(J.size(), 0);
+		for(size_t k = 0; k < J.size(); ++k){
+			rowInd[next[J[k]]] = I[k];
+			val[next[J[k]]++] = V[k];
+		}
+		// sums the repeated rows of each column, keeping the first of them
+		vector<size_t> last(n, (size_t)-1);
+		size_t nz = 0;
+		for(size_t j = 0; j < n; ++j){
+			size_t start = nz;
+			for(size_t p = colPtr[j]; p < colPtr[j+1]; ++p){
+				size_t i = rowInd[p];
+				if(last[i] != (size_t)-1 && last[i] >= start){
+					val[last[i]] += val[p];
+				} else {
+					last[i] = nz;
+					rowInd[nz] = i;
+					val[nz++] = val[p];
+				}
+			}
+			colPtr[j] = start;
+		}
+		colPtr[n] = nz;
+		rowInd.resize(nz);
+		val.resize(nz);
+	}
+
+	/**
+	 * @brief R = B - A*X, O(nnz)
+	 * @return squared norm of R
+	 */
+	template<class Vec>
+	double residue(Vec& X, Vec& B, Vec& R){
+		double errNorm = 0;
+		for(size_t i = 0; i < n; ++i)
+			R.at(i) = B.at(i);
+		for(size_t j = 0; j < n; ++j)
+			for(size_t p = colPtr[j]; p < colPtr[j+1]; ++p)
+				R.at(rowInd[p]) -= val[p] * X.at(j);
+		for(size_t i = 0; i < n; ++i)
+			errNorm += R.at(i)*R.at(i);
+		return errNorm;
+	}
+};
+
+/**
+ * @brief Fill reducing column order: minimum degree on the graph of A + A^T.
+ * Eliminating a node joins its neighbours into a clique, the next node is the one
+ * with the fewest neighbours. Depends only on the nonzero pattern
+ * @param Q return value, Q[k] is the column eliminated k-th
+ */
+inline void minimumDegree(SparseMatrix& A, vector<size_t>& Q){
+	const size_t none = (size_t)-1;
+	size_t n = A.size();
+	vector< vector<size_t> > adj(n);
+	vector<size_t> mark(n, none);
+	for(size_t j = 0; j < n; ++j){
+		for(size_t p = A.colPtr[j]; p < A.colPtr[j+1]; ++p){
+			size_t i = A.rowInd[p];
+			if(i != j && mark[i] != j){
+				mark[i] = j;
+				adj[i].push_back(j);
+				adj[j].push_back(i);
+			}
+		}
+	}
+	// A + A^T may have both (i,j) and (j,i)
+	for(size_t i = 0; i < n; ++i){
+		sort(adj[i].begin(), adj[i].end());
+		adj[i].erase(unique(adj[i].begin(), adj[i].end()), adj[i].end());
+	}
+	// lowest degree first, stale entries are skipped
+	typedef pair<size_t,size_t> Degree;
+	priority_queue< Degree, vector<Degree>, greater<Degree> > heap;
+	for(size_t i = 0; i < n; ++i)
+		heap.push(Degree(adj[i].size(), i));
+	vector<char> done(n, 0);
+	mark.assign(n, none);
+	Q.clear();
+	while(Q.size() < n){
+		size_t p = heap.top().second, degree = heap.top().first;
+		heap.pop();
+		if(done[p] || degree != adj[p].size())
+			continue;
+		done[p] = 1;
+		Q.push_back(p);
+		vector<size_t>& nb = adj[p];
+		for(size_t a = 0; a < nb.size(); ++a){
+			size_t u = nb[a];
+			vector<size_t>& au = adj[u];
+			// drops p, marks the neighbours u has, adds the rest of the clique
+			size_t w = 0;
+			for(size_t b = 0; b < au.size(); ++b){
+				if(au[b] != p){
+					mark[au[b]] = u;
+					au[w++] = au[b];
+				}
+			}
+			au.resize(w);
+			mark[u] = u;
+			for(size_t b = 0; b < nb.size(); ++b){
+				if(mark[nb[b]] != u){
+					mark[nb[b]] = u;
+					au.push_back(nb[b]);
+				}
+			}
+			heap.push(Degree(au.size(), u));
+		}
+		nb.clear();
+	}
+}
+
+/**
+ * @brief Symbolic analysis of a sparse matrix, reusable by the factorizations of any
+ * matrix with the same nonzero pattern: the fill reducing order and the L and U sizes
+ */
+struct SparseSymbolic
+{
+	vector<size_t> Q; // column order
+	size_t lnz, unz; // expected nonzeros of L and U, grown as factorizations find them
+
+	SparseSymbolic(SparseMatrix& A){
+		minimumDegree(A, Q);
+		lnz = unz = 4*A.nnz() + A.size();
+	}
+};
+
+/**
+ * @brief Left looking sparse LU with threshold partial pivoting (Gilbert-Peierls):
+ * P*A*Q = L*U, L unit lower triangular. Each column of L and U comes from a
+ * sparse triangular solve with L, whose nonzeros are found first by a depth
+ * first search on the graph of L, so the work is proportional to the flops
+ */
+class SparseLU
+{
+	size_t n;
+	vector<size_t> Lp, Li, Up, Ui;
+	vector<double> Lx, Ux;
+	vector<size_t> pinv; // pinv[i] is the pivot position of row i
+	vector<size_t> Q;
+	enum : size_t { none = (size_t)-1 }; // row not pivotal yet
+
+	/**
+	 * @brief Pushes onto xi the rows reachable from j in the graph of L so far,
+	 * after all the rows they reach: xi[top..n-1] is a topological order
+	 */
+	size_t reach(size_t j, size_t top, vector<size_t>& xi, vector<size_t>& stack,
+	vector<size_t>& next, vector<char>& marked){
+		size_t head = 0;
+		stack[0] = j;
+		while(head != none){
+			size_t i = stack[head];
+			size_t col = pinv[i];
+			if(not marked[i]){
+				marked[i] = 1;
+				next[head] = col == none ? 0 : Lp[col] + 1; // skips the unit diagonal
+			}
+			bool done = true;
+			size_t end = col == none ? 0 : Lp[col+1];
+			for(size_t p = next[head]; col != none && p < end; ++p){
+				size_t r = Li[p];
+				if(marked[r])
+					continue;
+				next[head] = p+1;
+				stack[++head] = r;
+				done = false;
+				break;
+			}
+			if(done){
+				head = head == 0 ? none : head-1;
+				xi[--top] = i;
+			}
+		}
+		return top;
+	}
+public:
+	/**
+	 * @brief Factors A in the order of the symbolic analysis S
+	 * @param tol the diagonal is kept as pivot if at least tol times the largest candidate
+	 * @return false if A is singular
+	 */
+	bool factor(SparseMatrix& A, SparseSymbolic& S, double tol = 0.1){
+		n = A.size();
+		Q = S.Q;
+		Lp.assign(n+1, 0); Up.assign(n+1, 0);
+		Li.clear(); Lx.clear(); Ui.clear(); Ux.clear();
+		Li.reserve(S.lnz); Lx.reserve(S.lnz);
+		Ui.reserve(S.unz); Ux.reserve(S.unz);
+		pinv.assign(n, none);
+		vector<double> x(n, 0);
+		vector<size_t> xi(n), stack(n), next(n);
+		vector<char> marked(n, 0);
+
+		for(size_t k = 0; k < n; ++k){
+			size_t col = Q[k];
+			// nonzeros of x = L \ A(:,col)
+			size_t top = n;
+			for(size_t p = A.colPtr[col]; p < A.colPtr[col+1]; ++p)
+				if(not marked[A.rowInd[p]])
+					top = reach(A.rowInd[p], top, xi, stack, next, marked);
+			for(size_t t = top; t < n; ++t)
+				marked[xi[t]] = 0;
+			for(size_t p = A.colPtr[col]; p < A.colPtr[col+1]; ++p)
+				x[A.rowInd[p]] = A.val[p];
+			// numeric solve in topological order
+			for(size_t t = top; t < n; ++t){
+				size_t j = pinv[xi[t]];
+				if(j == none)
+					continue;
+				for(size_t p = Lp[j] + 1; p < Lp[j+1]; ++p)
+					x[Li[p]] -= Lx[p] * x[xi[t]];
+			}
+			// pivotal rows go to U, the largest of the others is the pivot
+			size_t ipiv = none;
+			double amax = 0;
+			Up[k] = Ui.size();
+			for(size_t t = top; t < n; ++t){
+				size_t i = xi[t];
+				if(pinv[i] == none){
+					if(abs(x[i]) > amax){
+						amax = abs(x[i]);
+						ipiv = i;
+					}
+				} else {
+					Ui.push_back(pinv[i]);
+					Ux.push_back(x[i]);
+				}
+			}
+			if(ipiv == none || amax == 0)
+				return false;
+			// the diagonal keeps the fill reducing order if it is large enough
+			if(pinv[col] == none && abs(x[col]) >= tol*amax)
+				ipiv = col;
+			double pivot = x[ipiv];
+			Ui.push_back(k);
+			Ux.push_back(pivot);
+			Up[k+1] = Ui.size();
+			pinv[ipiv] = k;
+			Lp[k] = Li.size();
+			Li.push_back(ipiv);
+			Lx.push_back(1);
+			for(size_t t = top; t < n; ++t){
+				size_t i = xi[t];
+				if(pinv[i] == none){
+					Li.push_back(i);
+					Lx.push_back(x[i] / pivot);
+				}
+				x[i] = 0;
+			}
+			Lp[k+1] = Li.size();
+		}
+		// rows of L in pivot order
+		for(size_t p = 0; p < Li.size(); ++p)
+			Li[p] = pinv[Li[p]];
+		S.lnz = max(S.lnz, Li.size());
+		S.unz = max(S.unz, Ui.size());
+		return true;
+	}
+
+	/**
+	 * @brief log|det(A)| from U's diagonal, the signs of P and Q with it
+	 * @param sign return value, sign of det(A)
+	 */
+	double logDeterminant(int& sign){
+		sign = permutationSign(pinv, n) * permutationSign(Q, n);
+		double logDet = 0;
+		for(size_t j = 0; j < n; ++j){
+			double u = Ux[Up[j+1] - 1];
+			if(u < 0)
+				sign = -sign;
+			logDet += log(abs(u));
+		}
+		return logDet;
+	}
+
+	/** @brief nonzeros of L and U */
+	size_t nnz() const { return Li.size() + Ui.size(); }
+
+	/**
+	 * @brief Solves A*X = B, O(nnz(L+U))
+	 * @param Y work vector, n elems
+	 */
+	template<class Vec>
+	void solve(Vec& X, Vec& B, Vec& Y){
+		for(size_t i = 0; i < n; ++i)
+			Y.at(pinv[i]) = B.at(i);
+		// L*Z = P*B
+		for(size_t j = 0; j < n; ++j)
+			for(size_t p = Lp[j] + 1; p < Lp[j+1]; ++p)
+				Y.at(Li[p]) -= Lx[p] * Y.at(j);
+		// U*W = Z, the diagonal is the last of each column
+		for(size_t j = n; j-- > 0; ){
+			Y.at(j) /= Ux[Up[j+1] - 1];
+			for(size_t p = Up[j]; p < Up[j+1] - 1; ++p)
+				Y.at(Ui[p]) -= Ux[p] * Y.at(j);
+		}
+		for(size_t k = 0; k < n; ++k)
+			X.at(Q[k]) = Y.at(k);
+	}
+};
+
+
+}
+#endif
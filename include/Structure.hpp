@@ -0,0 +1,223 @@
+#ifndef STRUCTURE_H
+#define STRUCTURE_H
+
+#include <cmath>
+
+#include "Matrix.hpp"
+#include "Expression.hpp"
+
+namespace gm {
+using namespace std;
+
+/**
+ * @brief Finds the bandwidths of A, the farthest nonzero below and above the diagonal. \n
+ * Diagonal: 0,0; lower triangular: upper == 0; upper triangular: lower == 0; tridiagonal: 1,1
+ * O(n*n), each row is scanned from its ends only up to the bands found so far
+ */
+template<class AMatrix>
+void bandwidths(AMatrix& A, size_t& lower, size_t& upper){
+	size_t size = A.size();
+	lower = upper = 0;
+	for(size_t i = 0; i < size; ++i){
+		// first nonzero of the row, stops at the lower band found
+		for(size_t j = 0; j + lower < i; ++j){
+			if(A.at(i,j) != 0){
+				lower = i - j;
+				break;
+			}
+		}
+		// last nonzero of the row, stops at the upper band found
+		for(size_t j = size-1; j > i + upper; --j){
+			if(A.at(i,j) != 0){
+				upper = j - i;
+				break;
+			}
+		}
+	}
+}
+
+/**
+ * @brief Inverts a triangular (or diagonal) A, the inverse is triangular too.
+ * Column by column substitution limited to the band: O(n*n*b), O(n*n*n/6) when full
+ * @param lower, upper bandwidths of A, one of them 0
+ * @return false if a diagonal elem is 0
+ */
+template<class AMatrix, class IAMatrix>
+bool inverse_triangular(AMatrix& A, IAMatrix& IA, size_t lower, size_t upper){
+	ssize_t size = A.size();
+	ssize_t i, j, k;
+	for(i = 0; i < size; ++i)
+		if(A.at(i,i) == 0)
+			return false;
+	assign(IA, 0.0);
+	for(j = 0; j < size; ++j){
+		IA.at(j,j) = 1/A.at(j,j);
+		if(upper == 0){
+			// lower: forwards from the diagonal
+			for(i = j+1; i < size; ++i){
+				double x = 0;
+				for(k = max(j, i - (ssize_t)lower); k < i; ++k)
+					x -= A.at(i,k) * IA.at(k,j);
+				IA.at(i,j) = x / A.at(i,i);
+			}
+		} else {
+			// upper: backwards from the diagonal
+			for(i = j-1; i >= 0; --i){
+				double x = 0;
+				for(k = min(j, i + (ssize_t)upper); k > i; --k)
+					x -= A.at(i,k) * IA.at(k,j);
+				IA.at(i,j) = x / A.at(i,i);
+			}
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief LU with partial pivoting of a banded matrix in band storage, as LAPACK's gbtrf. \n
+ * Row i keeps columns i-lower .. i+upper+lower, the extra lower for the fill of the row swaps.
+ * O(n*b*b) time and O(n*b) memory
+ */
+class BandLU
+{
+	size_t mSize, mLower, mUpper, mWidth;
+	varray<double> band;
+	varray<size_t> piv; // row swapped with row p at step p
+
+	double& at(size_t i, size_t j){
+		return band.at(i*mWidth + j + mLower - i);
+	}
+public:
+	/** @param lower, upper bandwidths of the matrices factored */
+	BandLU(size_t size, size_t lower, size_t upper)
+		: mSize(size), mLower(lower), mUpper(upper), mWidth(2*lower + upper + 1),
+		band(size*(2*lower + upper + 1)), piv(size) {}
+
+	/**
+	 * @brief Factors A, only its bands are read
+	 * @return false if a pivot is 0, A is singular
+	 */
+	template<class AMatrix>
+	bool factor(AMatrix& A){
+		size_t n = mSize;
+		for(size_t i = 0; i < n; ++i){
+			size_t j0 = i > mLower ? i - mLower : 0;
+			for(size_t j = j0; j < i + mUpper + mLower + 1 && j < n; ++j)
+				at(i,j) = j <= i + mUpper ? A.at(i,j) : 0;
+		}
+		for(size_t p = 0; p < n; ++p){
+			size_t last = min(n-1, p + mLower); // last row with a nonzero in column p
+			size_t end = min(n-1, p + mUpper + mLower); // last column of U in row p
+			size_t maxRow = p;
+			for(size_t i = p+1; i <= last; ++i)
+				if(abs(at(i,p)) > abs(at(maxRow,p))) maxRow = i;
+			piv.at(p) = maxRow;
+			if(maxRow != p)
+				for(size_t j = p; j <= end; ++j)
+					swap(at(p,j), at(maxRow,j));
+			if(at(p,p) == 0)
+				return false;
+			for(size_t i = p+1; i <= last; ++i){
+				double l = at(i,p) / at(p,p);
+				at(i,p) = l;
+				for(size_t j = p+1; j <= end; ++j)
+					at(i,j) -= l * at(p,j);
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * @brief Solves A*x = b in place, O(n*b)
+	 * @param from first nonzero of b, the rows above it are skipped while they stay 0
+	 */
+	template<class Vec>
+	void solve(Vec& b, size_t from = 0){
+		size_t n = mSize;
+		// forwards, applying the swaps in the order they were done
+		for(size_t p = (from > mLower ? from - mLower : 0); p < n; ++p){
+			swap(b.at(p), b.at(piv.at(p)));
+			size_t last = min(n-1, p + mLower);
+			for(size_t i = p+1; i <= last; ++i)
+				b.at(i) -= at(i,p) * b.at(p);
+		}
+		// backwards on U
+		for(size_t i = n; i-- > 0; ){
+			size_t end = min(n-1, i + mUpper + mLower);
+			for(size_t j = i+1; j <= end; ++j)
+				b.at(i) -= at(i,j) * b.at(j);
+			b.at(i) /= at(i,i);
+		}
+	}
+};
+
+/**
+ * @brief Column j of a column major matrix as a vector, for BandLU::solve
+ */
+template<class Mat>
+struct Column {
+	Mat& M;
+	size_t j;
+	Column(Mat& M, size_t j) : M(M), j(j) {}
+	double& at(size_t i) { return M.at(i, j); }
+};
+
+/**
+ * @brief Inverts the banded A into IA, a banded LU and a solve per column of the identity.
+ * O(n*b*b) to factor, O(n*n*b) for the inverse, which is dense
+ * @return false if A is singular
+ */
+template<class AMatrix, class IAMatrix>
+bool inverse_banded(AMatrix& A, IAMatrix& IA, size_t lower, size_t upper){
+	size_t size = A.size();
+	BandLU LU(size, lower, upper);
+	if(not LU.factor(A))
+		return false;
+	assign(IA, IdentityExpr<double>());
+	for(size_t j = 0; j < size; ++j){
+		Column<IAMatrix> x(IA, j);
+		LU.solve(x, j);
+	}
+	return true;
+}
+
+/**
+ * @brief Inverts the tridiagonal A with the Thomas algorithm, no pivoting. \n
+ * The eliminated superdiagonal doesn't depend on the right hand side, it is
+ * found once; then each column of the identity is solved in O(n), O(n*n) total
+ * @return false if A isn't diagonally dominant, Thomas may be unstable
+ */
+template<class AMatrix, class IAMatrix>
+bool inverse_tridiagonal(AMatrix& A, IAMatrix& IA){
+	ssize_t size = A.size();
+	ssize_t i, j;
+	for(i = 0; i < size; ++i){
+		double off = (i > 0 ? abs(A.at(i,i-1)) : 0) + (i < size-1 ? abs(A.at(i,i+1)) : 0);
+		if(abs(A.at(i,i)) < off || A.at(i,i) == 0)
+			return false;
+	}
+	// c' superdiagonal and 1/(b - a*c') pivots of the elimination
+	varray<double> C(size), D(size);
+	D.at(0) = 1/A.at(0,0);
+	C.at(0) = size > 1 ? A.at(0,1) * D.at(0) : 0;
+	for(i = 1; i < size; ++i){
+		D.at(i) = 1/(A.at(i,i) - A.at(i,i-1) * C.at(i-1));
+		C.at(i) = i < size-1 ? A.at(i,i+1) * D.at(i) : 0;
+	}
+	for(j = 0; j < size; ++j){
+		// forwards, column j of the identity is 0 above j
+		for(i = 0; i < j; ++i)
+			IA.at(i,j) = 0;
+		IA.at(j,j) = D.at(j);
+		for(i = j+1; i < size; ++i)
+			IA.at(i,j) = -A.at(i,i-1) * IA.at(i-1,j) * D.at(i);
+		// backwards
+		for(i = size-2; i >= 0; --i)
+			IA.at(i,j) -= C.at(i) * IA.at(i+1,j);
+	}
+	return true;
+}
+
+
+}
+#endif
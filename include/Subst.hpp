@@ -4,6 +4,10 @@
 #include <assert.h>
 
 #include "Matrix.hpp"
+#include "MatrixView.hpp"
+#include "Elem.hpp"
+#include "Dispatch.hpp"
+#include "Tuning.hpp"
 
 namespace gm {
 
@@ -44,7 +48,7 @@ const Elem& at(varray<Elem> const& arr, size_t i, size_t j){
  * @param col Column of the matrix I to be used as B
  */
 template<Direction direction, Diagonal diagonal, Permute permute, class TMatrix, class XMatrix, class IMatrix>
-void subst(TMatrix& T, XMatrix& X, IMatrix& I, vector<size_t>& P, size_t col){
+void subst(TMatrix& T, XMatrix& X, IMatrix& I, varray<size_t>& P, size_t col){
 	size_t i, j;
 	int step;
 	size_t size = T.size();
@@ -75,80 +79,110 @@ void subst(TMatrix& T, XMatrix& X, IMatrix& I, vector<size_t>& P, size_t col){
 }
 
 /**
- * @brief Solves LU*X = B, B having LU.size() columns of independant terms.
- * Resulting in LU.size() columns of X, each being the solution to LU*x = B.col(j).
+ * @brief Solves LU*X = B, B having nCols(B) columns of independant terms, LU.size() for a square B.
+ * Resulting in nCols(B) columns of X, each being the solution to LU*x = B.col(j).
+ * X and B are column major with LU.sizeMem() elems per column, Matrix or MatrixRectColMajor.
  * Tiling on L0, SSE, and Unrolling on i,j
  * @param LU triangular matrix, Lower or Upper
  * @param X Matrix of solutions
  * @param B Matrix of independent terms
  * @param P Permutation obtained in GaussEl()
+ * @param iunr, junr rows and columns of X unrolled
  */
-template<Direction direction, Diagonal diagonal, Permute permute,
+template<Direction direction, Diagonal diagonal, Permute permute, size_t iunr, size_t junr,
 	class LUMatrix, class XMatrix, class BMatrix>
-inline void substMLU0AU(LUMatrix& LU, XMatrix& X, BMatrix& B, varray<size_t>& P){
+inline void substMLU0AUKernel(LUMatrix& LU, XMatrix& X, BMatrix& B, varray<size_t>& P){
 // Defines to index Matrices, if direction is backwards, access is reversed
 #define ind(M,i,j) (direction == Direction::Forwards ? \
 	M.at(i, j) : \
 	M.at((size-1)-(i), (size-1)-(j)))
-#define indvi(M,i,j) (direction == Direction::Forwards ? \
-	M.atv(i, j) : \
-	M.atv((size-1)/vn-(i), (size-1)-(j)))
 #define indvj(M,i,j) (direction == Direction::Forwards ? \
 	M.atv(i, j) : \
 	M.atv((size-1)-(i), (size-1)/vn-(j)))
+// X and B only have their rows reversed, the columns are independent
+#define indx(M,i,j) (direction == Direction::Forwards ? \
+	M.at(i, j) : \
+	M.at((size-1)-(i), j))
+#define indvi(M,i,j) (direction == Direction::Forwards ? \
+	M.atv(i, j) : \
+	M.atv((size-1)/vn-(i), j))
+// elems (vecs) of LU rows and X columns contiguous from k (kv) on, in the direction of the access
+#define elemRun(k) (direction == Direction::Forwards ? \
+	min(contiguousFrom(LU, k), contiguousFrom(X, k)) : \
+	min(contiguousTo(LU, (size-1)-(k)), contiguousTo(X, (size-1)-(k))))
+#define vecRun(kv) (elemRun((kv)*vn)/vn)
 
-	size_t size = X.sizeMem();
+	size_t size = LU.sizeMem();
+	size_t cols = nCols(X);
 	size_t i, j, k, kv;
 	size_t bi[5], bj[5], bk[5];
 	//size_t bimax[5], bjmax[5], bkmax[5];
 	size_t imax, jmax;
 	size_t bstep[5];
 	size_t isrt;
-	const size_t iunr = 2;
-	const size_t junr = 4;
 	/**/
-	bstep[0] = B2L1;
-	bstep[1] = bstep[0]*3;
+	bstep[0] = tuning().subst.tileOf<typename ElemOf<LUMatrix>::type>();
+	bstep[1] = tileL2<typename ElemOf<LUMatrix>::type>(bstep[0]);
+	bstep[2] = tileL3<typename ElemOf<LUMatrix>::type>(bstep[1]);
 	/* export GCC_ARGS=" -D L0=${32} -D L1M=${3}"*
 	bstep[0] = L0;
 	bstep[1] = bstep[0]*L1M;/**/
 
-	for(j = 0; j < size; ++j)
+	for(j = 0; j < cols; ++j)
 		for(i = 0; i < size; ++i)
 			if(permute == Permute::True)
-				ind(X, i, j) = ind(B, P.at(i), j);
+				indx(X, i, j) = indx(B, P.at(i), j);
 			else
-				ind(X, i, j) = ind(B, i, j);
+				indx(X, i, j) = indx(B, i, j);
 
-	size_t vn = X.vecN(); // number of doubles in vec
-	vec<double> acc[iunr*junr];
+	typedef typename ElemOf<LUMatrix>::type Elem;
+	size_t vn = X.vecN(); // number of elems in vec
+	vec<Elem> acc[iunr*junr];
+	// LU rows and X columns of the run being multiplied, walked backwards if the access is reversed
+	const vec<Elem>* a[iunr];
+	const vec<Elem>* b[junr];
+	const ssize_t step = direction == Direction::Forwards ? 1 : -1;
+	ssize_t r;
+	size_t run;
 	
 #define vect(v) for(size_t v=0; v < vn; ++v) // ease vectorization
 #define unrll(u,step) for(size_t u = 0; u < step; ++u) // ease unrolling
 #define unr(iu,iunr,ju,junr) unrll(iu,iunr) unrll(ju,junr) // unroll 2 dimensions
 	
-	for (bi[0] = 0; bi[0] < size; bi[0] += bstep[0]) // L1 tiling
-	for (bj[0] = 0; bj[0] < size; bj[0] += bstep[0]) {
+	// k tiles before the diagonal one; the L2 and L3 k tiles go up to the one holding it
+	for (bi[2] = 0; bi[2] < size; bi[2] += bstep[2]) // L3 tiling
+	for (bj[2] = 0; bj[2] < cols; bj[2] += bstep[2])
+	for (bk[2] = 0; bk[2] <= bi[2]; bk[2] += bstep[2])
+	for (bi[1] = bi[2]; bi[1] < min(bi[2]+bstep[2], size); bi[1] += bstep[1]) // L2 tiling
+	for (bj[1] = bj[2]; bj[1] < min(bj[2]+bstep[2], cols); bj[1] += bstep[1])
+	for (bk[1] = bk[2]; bk[1] < min(bk[2]+bstep[2], bi[1]+1); bk[1] += bstep[1])
+	for (bi[0] = bi[1]; bi[0] < min(bi[1]+bstep[1], size); bi[0] += bstep[0]) // L1 tiling
+	for (bj[0] = bj[1]; bj[0] < min(bj[1]+bstep[1], cols); bj[0] += bstep[0]) {
 		imax = min(bi[0]+bstep[0] , size); // setting tile limits
-		jmax = min(bj[0]+bstep[0] , size);
+		jmax = min(bj[0]+bstep[0] , cols);
 		if(direction == Direction::Forwards)
 			isrt = bi[0];
-		else isrt = max(bi[0], X.pad());
-		for (bk[0] = 0; bk[0] < (bi[0]); bk[0] += bstep[0]) {
+		else isrt = max(bi[0], LU.pad());
+		for (bk[0] = bk[1]; bk[0] < min(bk[1]+bstep[1], bi[0]); bk[0] += bstep[0]) {
 			for (i = bi[0]; i < imax -(iunr-1); i += iunr) { // i unroll
-				for (j = bj[0]; j < jmax -(junr-1); j += junr) { // j unroll
-assert(((direction == Direction::Backwards) && (((size-1-bk[0])-(vn-1)) % 4 == 0))
-|| ((direction == Direction::Forwards) && (bk[0] % 4 == 0))); // So that vectorization doesn't give segfault -O2
+				for (j = bj[0]; j + (junr-1) < jmax; j += junr) { // j unroll, jmax may be below junr
+assert(((direction == Direction::Backwards) && (((size-1-bk[0])-(vn-1)) % vn == 0))
+|| ((direction == Direction::Forwards) && (bk[0] % vn == 0))); // So that vectorization doesn't give segfault -O2
 // Multiply current tile: i,j = A krow * IA kcol
 // For (i,j): from i to i+iunr; from j to j+junr
 #define kloop(iunr, junr)	\
-					unr(iu,iunr,ju,junr) vect(v) acc[iu*junr + ju][v] = 0;	\
-					/*vectorized loop*/	\
-					for (kv = bk[0]/vn; kv < (bk[0]+bstep[0])/vn; ++kv)	\
-						unr(iu,iunr,ju,junr)	\
-						acc[iu*junr+ju].v += indvj(LU, i+iu, kv).v * indvi(X, kv, j+ju).v;	\
+					unr(iu,iunr,ju,junr) acc[iu*junr + ju] = vec<Elem>{};	\
+					/*vectorized loop, by contiguous runs*/	\
+					for (kv = bk[0]/vn; kv < (bk[0]+bstep[0])/vn; kv += run) {	\
+						run = min((bk[0]+bstep[0])/vn - kv, vecRun(kv));	\
+						unrll(iu,iunr) a[iu] = &indvj(LU, i+iu, kv);	\
+						unrll(ju,junr) b[ju] = &indvi(X, kv, j+ju);	\
+						for (r = 0; r < (ssize_t)run; ++r)	\
+							unr(iu,iunr,ju,junr)	\
+							acc[iu*junr+ju].v += a[iu][r*step].v * b[ju][r*step].v;	\
+					}	\
 					unr(iu,iunr,ju,junr) /*vect result sum*/	\
-					vect(v) ind(X, i+iu, j+ju) -= acc[iu*junr+ju][v];
+					vect(v) indx(X, i+iu, j+ju) -= acc[iu*junr+ju][v];
 // end define
 					kloop(iunr,junr)
 				}
@@ -157,7 +191,7 @@ assert(((direction == Direction::Backwards) && (((size-1-bk[0])-(vn-1)) % 4 == 0
 				}
 			}
 			for (i = i; i < imax; ++i) { // i unroll remainder
-				for (j = bj[0]; j < jmax -(junr-1); j += junr) { // j unroll
+				for (j = bj[0]; j + (junr-1) < jmax; j += junr) { // j unroll, jmax may be below junr
 					kloop(1,junr)
 				}
 				for (j = j; j < jmax; ++j) { // j unroll reminder
@@ -165,13 +199,21 @@ assert(((direction == Direction::Backwards) && (((size-1-bk[0])-(vn-1)) % 4 == 0
 				}
 			}
 		} // Last block in K, diagonal, divide by pivot
+		if(bk[1] == bi[1] && bk[2] == bi[2])
 		for (bk[0] = (bi[0]); bk[0] < (bi[0]+bstep[0]); bk[0] += bstep[0]) {
 			for (i = isrt; i < imax; ++i)
 			for (j = bj[0]; j < jmax; ++j) {
-				for (k = bk[0]; k < i; ++k)
-					ind(X, i, j) = ind(X, i, j) - ind(LU, i, k) * ind(X, k, j);
+				Elem xij = indx(X, i, j);
+				for (k = bk[0]; k < i; k += run) { // by contiguous runs
+					run = min(i - k, elemRun(k));
+					const Elem* l = &ind(LU, i, k);
+					const Elem* x = &indx(X, k, j);
+					for (r = 0; r < (ssize_t)run; ++r)
+						xij = xij - l[r*step] * x[r*step];
+				}
 				if(diagonal == Diagonal::Value)
-					ind(X, i, j) /= ind(LU, i, i);
+					xij /= ind(LU, i, i);
+				indx(X, i, j) = xij;
 			}
 		}
 	}
@@ -180,8 +222,31 @@ assert(((direction == Direction::Backwards) && (((size-1-bk[0])-(vn-1)) % 4 == 0
 #undef unr
 #undef kloop
 #undef ind
+#undef indx
 #undef indvi
 #undef indvj
+#undef elemRun
+#undef vecRun
+}
+/**
+ * @brief substMLU0AUKernel compiled for the instruction set of the host, see dispatch()
+ */
+template<Direction direction, Diagonal diagonal, Permute permute, size_t iunr, size_t junr,
+	class LUMatrix, class XMatrix, class BMatrix>
+inline void substMLU0AUDispatch(LUMatrix& LU, XMatrix& X, BMatrix& B, varray<size_t>& P){
+	dispatch([&]{ substMLU0AUKernel<direction, diagonal, permute, iunr, junr>(LU, X, B, P); });
+}
+/**
+ * @brief substMLU0AUDispatch with the unrolling of tuning()
+ */
+template<Direction direction, Diagonal diagonal, Permute permute,
+	class LUMatrix, class XMatrix, class BMatrix>
+inline void substMLU0AU(LUMatrix& LU, XMatrix& X, BMatrix& B, varray<size_t>& P){
+	typedef typename ElemOf<LUMatrix>::type Elem;
+	const KernelTuning& tuned = tuning().subst;
+#define call(iunr, junr) substMLU0AUDispatch<direction, diagonal, permute, iunr, junr>(LU, X, B, P)
+	unrolled(call, Elem, tuned.iunr, tuned.junr)
+#undef call
 }
 
 /**
@@ -217,7 +282,7 @@ inline void substMLU0A(LUMatrix& LU, XMatrix& X, BMatrix& B, varray<size_t>& P){
 	//const size_t unr = 2;
 	//double acc[unr*unr];
 	/**/
-	bstep[0] = B2L1;
+	bstep[0] = tileL1<typename ElemOf<LUMatrix>::type>();
 	bstep[1] = bstep[0]*3;
 	/* export GCC_ARGS=" -D L0=${32} -D L1M=${3}"*
 	bstep[0] = L0;
@@ -229,7 +294,7 @@ inline void substMLU0A(LUMatrix& LU, XMatrix& X, BMatrix& B, varray<size_t>& P){
 			else
 				ind(X, i, j) = ind(B, i, j);
 	size_t vn = X.vecN();
-	vec<double> acc;
+	vec<typename ElemOf<LUMatrix>::type> acc;
 	
 #define vect(v) for(size_t v = 0; v < vn; ++v)
 	
@@ -243,8 +308,8 @@ inline void substMLU0A(LUMatrix& LU, XMatrix& X, BMatrix& B, varray<size_t>& P){
 		for (bk[0] = 0; bk[0] < (bi[0]); bk[0] += bstep[0]) {
 			for (i = bi[0]; i < imax; ++i)
 			for (j = bj[0]; j < jmax; ++j) {
-				assert( ((direction == Direction::Backwards) && (((size-1-bk[0])-(vn-1)) % 4 == 0))
-				|| ((direction == Direction::Forwards) && (bk[0] % 4 == 0)));
+				assert( ((direction == Direction::Backwards) && (((size-1-bk[0])-(vn-1)) % vn == 0))
+				|| ((direction == Direction::Forwards) && (bk[0] % vn == 0)));
 				vect(v)
 					acc[v] = 0;
 				for (kv = bk[0]/vn; kv < (bk[0]+bstep[0])/vn; ++kv)
@@ -0,0 +1,209 @@
+#ifndef TOEPLITZ_H
+#define TOEPLITZ_H
+
+#include <cmath>
+#include <complex>
+#include <vector>
+
+#include "Matrix.hpp"
+
+namespace gm {
+using namespace std;
+
+/**
+ * @brief true if A(i,j) only depends on i-j, A is then given by its first row and column
+ */
+template<class AMatrix>
+bool isToeplitz(AMatrix& A){
+	size_t size = A.size();
+	for(size_t i = 1; i < size; ++i)
+		for(size_t j = 1; j < size; ++j)
+			if(A.at(i,j) != A.at(i-1,j-1))
+				return false;
+	return true;
+}
+
+/**
+ * @brief true if the Toeplitz A wraps around, A(i,j) only depends on (i-j) mod n
+ */
+template<class AMatrix>
+bool isCirculant(AMatrix& A){
+	size_t size = A.size();
+	for(size_t k = 1; k < size; ++k)
+		if(A.at(0,k) != A.at(size-k,0))
+			return false;
+	return true;
+}
+
+/**
+ * @brief Fills the Toeplitz A from its first column and row, row(0) is not used
+ */
+template<class AMatrix>
+void toeplitzMatrix(AMatrix& A, varray<double>& col, varray<double>& row){
+	size_t size = A.size();
+	for(size_t i = 0; i < size; ++i)
+		for(size_t j = 0; j < size; ++j)
+			A.at(i,j) = i >= j ? col.at(i-j) : row.at(j-i);
+}
+
+/**
+ * @brief Toeplitz matrix given only by its first column and row, O(n) memory:
+ * at() reads the generator. Stands for the full matrix in the O(n*n) methods
+ */
+struct ToeplitzMatrix
+{
+	varray<double>& col;
+	varray<double>& row;
+	
+	ToeplitzMatrix(varray<double>& col, varray<double>& row) : col(col), row(row) {}
+	size_t size() const { return col.size(); }
+	double at(size_t i, size_t j) const { return i >= j ? col.at(i-j) : row.at(j-i); }
+};
+
+/**
+ * @brief Z = X - T*Y from the generator of T, O(n*n); the product of residueEstimate
+ */
+inline void subMultVec(ToeplitzMatrix& T, varray<double>& X, varray<double>& Y, varray<double>& Z){
+	ssize_t size = T.size();
+	for(ssize_t i = 0; i < size; ++i){
+		double acc = 0;
+		for(ssize_t j = 0; j <= i; ++j)
+			acc += T.col.at(i-j) * Y.at(j);
+		for(ssize_t j = i+1; j < size; ++j)
+			acc += T.row.at(j-i) * Y.at(j);
+		Z.at(i) = X.at(i) - acc;
+	}
+}
+
+/**
+ * @brief Nonsymmetric Levinson recursion, solves T*f = e_0 and T*b = e_n-1 in O(n*n)
+ * growing the solutions on the leading blocks of T
+ * @param col first column of T, T(k,0) = col(k)
+ * @param row first row of T, T(0,k) = row(k)
+ * @return false if a leading block of T is singular, Levinson can't go through it
+ */
+inline bool levinson(varray<double>& col, varray<double>& row, varray<double>& f, varray<double>& b){
+	size_t size = col.size();
+	vector<double> fn(size), bn(size);
+	if(col.at(0) == 0)
+		return false;
+	f.at(0) = b.at(0) = 1/col.at(0);
+	for(size_t m = 1; m < size; ++m){
+		// T_m+1 [f;0] = e_0 + ef*e_m, T_m+1 [0;b] = eb*e_0 + e_m
+		double ef = 0, eb = 0;
+		for(size_t k = 0; k < m; ++k){
+			ef += col.at(m-k) * f.at(k);
+			eb += row.at(k+1) * b.at(k);
+		}
+		double d = 1 - ef*eb;
+		if(d == 0)
+			return false;
+		fn[0] = f.at(0)/d;
+		bn[0] = -eb*f.at(0)/d;
+		for(size_t k = 1; k < m; ++k){
+			fn[k] = (f.at(k) - ef*b.at(k-1))/d;
+			bn[k] = (b.at(k-1) - eb*f.at(k))/d;
+		}
+		fn[m] = -ef*b.at(m-1)/d;
+		bn[m] = b.at(m-1)/d;
+		for(size_t k = 0; k <= m; ++k){
+			f.at(k) = fn[k];
+			b.at(k) = bn[k];
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief Inverts the Toeplitz T given by its first column and row in O(n*n). \n
+ * With x and y the first and last columns of the inverse (Levinson), the
+ * Gohberg-Semencul formula gives each elem from its upper left neighbour: \n
+ * IA(i,j) = IA(i-1,j-1) + (x_i*y_n-1-j - y_i-1*x_n-j)/x_0 \n
+ * IA(i,0) = x_i, IA(0,j) = y_n-1-j
+ * @return false if a leading block of T is singular or x_0 == 0
+ */
+template<class IAMatrix>
+bool inverse_toeplitz(varray<double>& col, varray<double>& row, IAMatrix& IA){
+	ssize_t size = col.size();
+	ssize_t i, j;
+	varray<double> x(size), y(size);
+	if(not levinson(col, row, x, y) || x.at(0) == 0)
+		return false;
+	double ix0 = 1/x.at(0);
+	for(i = 0; i < size; ++i)
+		IA.at(i,0) = x.at(i);
+	for(j = 1; j < size; ++j){
+		IA.at(0,j) = y.at(size-1-j);
+		for(i = 1; i < size; ++i)
+			IA.at(i,j) = IA.at(i-1,j-1) + (x.at(i)*y.at(size-1-j) - y.at(i-1)*x.at(size-j)) * ix0;
+	}
+	return true;
+}
+
+/**
+ * @brief In place discrete Fourier transform of X, inverse if sign > 0 (not scaled by 1/n).
+ * Iterative radix 2 FFT, O(n log n), when n is a power of 2, else the O(n*n) sum
+ */
+inline void dft(vector< complex<double> >& X, int sign){
+	size_t n = X.size();
+	if(n & (n-1)){
+		vector< complex<double> > Y(n);
+		for(size_t k = 0; k < n; ++k){
+			Y[k] = 0;
+			for(size_t t = 0; t < n; ++t)
+				Y[k] += X[t] * polar(1.0, sign*2*M_PI*(double)((k*t) % n)/n);
+		}
+		X = Y;
+		return;
+	}
+	// bit reversal permutation
+	for(size_t i = 1, j = 0; i < n; ++i){
+		size_t bit = n >> 1;
+		for(; j & bit; bit >>= 1)
+			j ^= bit;
+		j ^= bit;
+		if(i < j)
+			swap(X[i], X[j]);
+	}
+	for(size_t len = 2; len <= n; len <<= 1){
+		complex<double> w = polar(1.0, sign*2*M_PI/len);
+		for(size_t i = 0; i < n; i += len){
+			complex<double> wk = 1;
+			for(size_t k = 0; k < len/2; ++k){
+				complex<double> u = X[i+k], v = X[i+k+len/2] * wk;
+				X[i+k] = u + v;
+				X[i+k+len/2] = u - v;
+				wk *= w;
+			}
+		}
+	}
+}
+
+/**
+ * @brief Inverts the circulant C given by its first column. The DFT diagonalizes C,
+ * the inverse is circulant with first column IDFT(1/DFT(col)): O(n log n) for it,
+ * O(n*n) to write out the inverse
+ * @return false if an eigenvalue of C, DFT(col), is 0
+ */
+template<class IAMatrix>
+bool inverse_circulant(varray<double>& col, IAMatrix& IA){
+	size_t size = col.size();
+	vector< complex<double> > X(size);
+	for(size_t k = 0; k < size; ++k)
+		X[k] = col.at(k);
+	dft(X, -1);
+	for(size_t k = 0; k < size; ++k){
+		if(abs(X[k]) == 0)
+			return false;
+		X[k] = 1.0 / (X[k] * (double)size);
+	}
+	dft(X, +1);
+	for(size_t j = 0; j < size; ++j)
+		for(size_t i = 0; i < size; ++i)
+			IA.at(i,j) = X[(i + size - j) % size].real();
+	return true;
+}
+
+
+}
+#endif
@@ -0,0 +1,149 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <iostream>
+
+#include "Bytes.h"
+
+namespace gm {
+using namespace std;
+
+/**
+ * @brief Data cache hierarchy of the host, sizes in bytes. \n
+ * The tile sizes of the kernels are derived from it at runtime as Bytes.h does at
+ * compile time: half of each level is considered usable, tiles are a multiple of a line,
+ * the L2 and L3 tiles a multiple of the tile of the level below
+ */
+struct CacheTopology
+{
+	size_t line; // cache line
+	size_t l1, l2, l3; // data or unified cache of each level, 0 if absent
+	const char* source; // where the sizes come from: sysfs, Bytes.h or the command line
+	size_t tile; // L1 tile in elems given in the command line, 0 to derive it
+
+	/** @brief The values Bytes.h was written for */
+	CacheTopology() : line(CACHE_LINE_SIZE), l1(L1KiB*1024), l2(2*CACHE_L2_SIZE),
+		l3(2*CACHE_L3_SIZE), source("Bytes.h"), tile(0) {}
+
+	/**
+	 * @brief Side of the square tile of elemSize bytes elems fitting `matrices` of them
+	 * in the usable part of a cache of bytes, a multiple of a line
+	 */
+	size_t fit(size_t bytes, size_t matrices, size_t elemSize) const {
+		size_t lineN = line/elemSize > 0 ? line/elemSize : 1;
+		size_t side = (size_t)sqrt((double)(bytes/2/elemSize/matrices));
+		return side > lineN ? Lower_Multiple(side, lineN) : lineN;
+	}
+	/** @brief side rounded down to a whole line of Elem, at least one line */
+	template<class Elem>
+	size_t lineTile(size_t side) const {
+		size_t lineN = line/sizeof(Elem) > 0 ? line/sizeof(Elem) : 1;
+		return side > lineN ? Lower_Multiple(side, lineN) : lineN;
+	}
+	/** @brief Tile of 2 matrices of Elem in L1 (B2L1), or the one given */
+	template<class Elem>
+	size_t tileB2L1() const {
+		if(tile == 0)
+			return fit(l1, 2, sizeof(Elem));
+		return lineTile<Elem>(tile);
+	}
+	/**
+	 * @brief Tile of 2 matrices of Elem in a cache of bytes above L1, a multiple of
+	 * the tile inner of the level below; inner if the cache is absent or not larger
+	 */
+	template<class Elem>
+	size_t tileOuter(size_t bytes, size_t inner) const {
+		size_t side = bytes > 0 ? fit(bytes, 2, sizeof(Elem)) : 0;
+		return side > inner ? Lower_Multiple(side, inner) : inner;
+	}
+};
+
+/** @brief Reads a size of sysfs, e.g. "48K", in bytes; 0 if it can't */
+inline size_t readCacheSize(const char* path){
+	FILE* f = fopen(path, "r");
+	if(f == NULL)
+		return 0;
+	size_t n = 0;
+	char unit = 0;
+	int read = fscanf(f, "%zu%c", &n, &unit);
+	fclose(f);
+	if(read < 1)
+		return 0;
+	return unit == 'K' ? n*1024 : unit == 'M' ? n*1024*1024 : unit == 'G' ? n*1024*1024*1024 : n;
+}
+
+/**
+ * @brief Cache hierarchy of cpu0 from /sys/devices/system/cpu/cpu0/cache,
+ * the Bytes.h values for the levels not found
+ */
+inline CacheTopology readCacheTopology(){
+	CacheTopology topo;
+	char path[96], type[32];
+	for(size_t index = 0; index < 16; ++index){
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%zu/type", index);
+		FILE* f = fopen(path, "r");
+		if(f == NULL)
+			break;
+		bool typeRead = fscanf(f, "%31s", type) == 1;
+		fclose(f);
+		if(not typeRead || strcmp(type, "Instruction") == 0)
+			continue;
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%zu/level", index);
+		size_t level = readCacheSize(path);
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%zu/size", index);
+		size_t bytes = readCacheSize(path);
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%zu/coherency_line_size", index);
+		size_t line = readCacheSize(path);
+		if(bytes == 0)
+			continue;
+		if(level == 1) topo.l1 = bytes;
+		else if(level == 2) topo.l2 = bytes;
+		else if(level == 3) topo.l3 = bytes;
+		else continue;
+		if(line > 0)
+			topo.line = line;
+		topo.source = "sysfs";
+	}
+	return topo;
+}
+
+/** @brief Cache hierarchy the kernels are tiled for, read on first use; may be overridden */
+inline CacheTopology& cacheTopology(){
+	static CacheTopology topo = readCacheTopology();
+	return topo;
+}
+
+/** @brief L1 tile of the kernels on Elem matrices, replaces B2L1 */
+template<class Elem>
+inline size_t tileL1(){
+	return cacheTopology().tileB2L1<Elem>();
+}
+/** @brief L2 tile of the kernels on Elem matrices tiled by l1Tile in L1 */
+template<class Elem>
+inline size_t tileL2(size_t l1Tile){
+	return cacheTopology().tileOuter<Elem>(cacheTopology().l2, l1Tile);
+}
+/** @brief L3 tile of the kernels on Elem matrices tiled by l2Tile in L2 */
+template<class Elem>
+inline size_t tileL3(size_t l2Tile){
+	return cacheTopology().tileOuter<Elem>(cacheTopology().l3, l2Tile);
+}
+
+/**
+ * @brief Prints the cache hierarchy and the tiles of double in a line of comment
+ */
+inline void printCacheTopology(){
+	const CacheTopology& topo = cacheTopology();
+	size_t l1Tile = topo.tileB2L1<double>();
+	size_t l2Tile = tileL2<double>(l1Tile);
+	cout<<"# Cache: L1 "<< topo.l1/1024 <<" KiB, L2 "<< topo.l2/1024 <<" KiB, L3 "<< topo.l3/1024
+		<<" KiB, linha "<< topo.line <<" B ("<< topo.source <<")"
+		<<", bloco L1 "<< l1Tile <<", L2 "<< l2Tile <<", L3 "<< tileL3<double>(l2Tile) <<"\n";
+}
+
+
+}
+#endif
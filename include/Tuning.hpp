@@ -0,0 +1,176 @@
+#ifndef TUNING_H
+#define TUNING_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <complex>
+
+#include "Dispatch.hpp"
+#include "Topology.hpp"
+#include "Elem.hpp"
+
+namespace gm {
+using namespace std;
+
+/**
+ * @brief Parameters of a tiled and unrolled kernel, the hard-coded ones by default
+ */
+struct KernelTuning
+{
+	size_t tile; // side of the L1 tile, 0 for tileL1() of the cache topology
+	size_t iunr, junr; // rows and columns of the result unrolled, one of unrolled()'s
+
+	KernelTuning() : tile(0), iunr(2), junr(4) {}
+
+	/** @brief L1 tile on Elem matrices: the tuned one, unless --tile was given */
+	template<class Elem>
+	size_t tileOf() const {
+		return tile != 0 && cacheTopology().tile == 0 ? tile : tileL1<Elem>();
+	}
+};
+
+/**
+ * @brief What the kernels run with: the instruction set chosen for the LU,
+ * the parameters of the substitutions (substMLU0AU) and of the residue (multSub0AUIJ, residue0AUIJFused)
+ */
+struct Tuning
+{
+	Isa isa;
+	KernelTuning subst, residue;
+
+	Tuning() : isa(detectIsa()) {}
+};
+
+/** @brief Tuning the kernels run with, the defaults until a profile is loaded */
+inline Tuning& tuning(){
+	static Tuning t;
+	return t;
+}
+
+/** @brief Unroll factors the kernels are compiled with, i x j; the first is the default */
+const size_t unrollCandidates[][2] = { {2,4}, {2,2}, {4,4}, {2,8} };
+const size_t unrollCandidatesN = sizeof(unrollCandidates)/sizeof(unrollCandidates[0]);
+
+/**
+ * @brief Unrolling i x j of the kernels on Elem matrices. Complex ones are only compiled
+ * with the default: their vecs are already several registers, and each candidate is
+ * a copy of the kernels for each instruction set
+ */
+template<class Elem, size_t i, size_t j>
+struct Unroll {
+	static const size_t iunr = i, junr = j;
+	static const bool tuned = true;
+};
+template<class T, size_t i, size_t j>
+struct Unroll<complex<T>, i, j> {
+	static const size_t iunr = 2, junr = 4;
+	static const bool tuned = false;
+};
+
+/**
+ * @brief Calls call(i,j), a macro calling a kernel with i x j unrolling as template arguments,
+ * with the candidate equal to iu x ju; the default if none is or Elem has only it
+ */
+#define unrolled(call, Elem, iu, ju) \
+	if((iu) == 2 && (ju) == 2) { call((Unroll<Elem,2,2>::iunr), (Unroll<Elem,2,2>::junr)); } \
+	else if((iu) == 4 && (ju) == 4) { call((Unroll<Elem,4,4>::iunr), (Unroll<Elem,4,4>::junr)); } \
+	else if((iu) == 2 && (ju) == 8) { call((Unroll<Elem,2,8>::iunr), (Unroll<Elem,2,8>::junr)); } \
+	else { call(2,4); }
+
+/**
+ * @brief Bucket of the matrix sizes a profile entry applies to: the power of 2
+ * not above size, the entry covers up to twice it
+ */
+inline size_t sizeBucket(size_t size){
+	size_t bucket = 1;
+	while(bucket*2 <= size)
+		bucket *= 2;
+	return bucket;
+}
+
+/** @brief Profile of this host in the home directory: ~/.invmat-<hostname>.profile */
+inline string defaultProfile(){
+	char host[256] = "local";
+	gethostname(host, sizeof(host));
+	host[sizeof(host)-1] = 0;
+	const char* home = getenv("HOME");
+	return string(home ? home : ".") + "/.invmat-" + host + ".profile";
+}
+
+/**
+ * @brief Line of a profile: elem, size bucket, isa, then tile iunr junr
+ * of the substitutions and of the residue
+ */
+inline string profileLine(const char* elem, size_t bucket, const Tuning& t){
+	stringstream line;
+	line<< elem <<" "<< bucket <<" "<< isaName(t.isa)
+		<<" "<< t.subst.tile <<" "<< t.subst.iunr <<" "<< t.subst.junr
+		<<" "<< t.residue.tile <<" "<< t.residue.iunr <<" "<< t.residue.junr;
+	return line.str();
+}
+
+/**
+ * @brief Reads from file the entry of Elem matrices in the size bucket of size into t.
+ * Tiles are rounded down to a whole line, as the kernels need: the file may be edited
+ * or come from a host with another line
+ * @return false if there's no such entry, t unchanged
+ */
+template<class Elem>
+inline bool loadTuning(const char* file, size_t size, Tuning& t){
+	ifstream in(file);
+	string line;
+	size_t bucket = sizeBucket(size);
+	while(getline(in, line)){
+		if(line.empty() || line[0] == '#')
+			continue;
+		stringstream fields(line);
+		string e, isa;
+		size_t b;
+		Tuning read;
+		fields>> e >> b >> isa >> read.subst.tile >> read.subst.iunr >> read.subst.junr
+			>> read.residue.tile >> read.residue.iunr >> read.residue.junr;
+		if(not fields || e != elemName<Elem>() || b != bucket || not isaFromName(isa.c_str(), read.isa))
+			continue;
+		KernelTuning* kernels[] = { &read.subst, &read.residue };
+		for(size_t k = 0; k < 2; ++k)
+			if(kernels[k]->tile != 0) // 0 keeps tileL1()
+				kernels[k]->tile = cacheTopology().lineTile<Elem>(kernels[k]->tile);
+		t = read;
+		return true;
+	}
+	return false;
+}
+
+/**
+ * @brief Writes t as the entry of elem matrices in the size bucket of size,
+ * replacing the one there was; the other entries are kept
+ * @return false if file can't be written
+ */
+inline bool saveTuning(const char* file, const char* elem, size_t size, const Tuning& t){
+	vector<string> lines;
+	string line;
+	stringstream key;
+	key<< elem <<" "<< sizeBucket(size) <<" ";
+	ifstream in(file);
+	while(getline(in, line))
+		if(not line.empty() && line[0] != '#' && line.compare(0, key.str().size(), key.str()) != 0)
+			lines.push_back(line);
+	in.close();
+	lines.push_back(profileLine(elem, sizeBucket(size), t));
+
+	ofstream out(file);
+	out<<"# elem tamanho isa subst:bloco,iunr,junr residuo:bloco,iunr,junr\n";
+	for(size_t l = 0; l < lines.size(); ++l)
+		out<< lines[l] <<"\n";
+	return (bool)out;
+}
+
+
+}
+#endif
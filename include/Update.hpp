@@ -0,0 +1,132 @@
+#ifndef UPDATE_H
+#define UPDATE_H
+
+#include <vector>
+
+#include "Matrix.hpp"
+#include "GaussEl.hpp"
+#include "SolveLU.hpp"
+
+namespace gm {
+using namespace std;
+
+/**
+ * @brief Y = IA*U, U with U.size() columns, axpy on each IA column
+ */
+template<class IAMatrix>
+inline void multCols(IAMatrix& IA, vector< varray<double> >& U, vector< varray<double> >& Y){
+	ssize_t size = IA.size();
+	ssize_t i, j, iv;
+	ssize_t vn = IA.vecN();
+	for(size_t c = 0; c < U.size(); ++c){
+		for(i = 0; i < size; ++i)
+			Y[c].at(i) = 0;
+		for(j = 0; j < size; ++j){
+			vec<double> u;
+			for(ssize_t v = 0; v < vn; ++v) u[v] = U[c].at(j);
+			for(iv = 0; iv < Y[c].sizeVec(); ++iv) // vect loop
+				Y[c].atv(iv).v += IA.atv(iv,j).v * u.v;
+			for(i = Y[c].remStart(); i < size; ++i) // vect remainder
+				Y[c].at(i) += IA.at(i,j) * U[c].at(j);
+		}
+	}
+}
+
+/**
+ * @brief A += U*V^T, U and V with U.size() columns
+ */
+template<class AMatrix>
+inline void addUpdate(AMatrix& A, vector< varray<double> >& U, vector< varray<double> >& V){
+	for(size_t i = 0; i < A.size(); ++i)
+		for(size_t a = 0; a < U.size(); ++a)
+			for(size_t j = 0; j < A.size(); ++j)
+				A.at(i,j) += U[a].at(i) * V[a].at(j);
+}
+
+/**
+ * @brief Updates the inverse of A to the inverse of A + U*V^T, U and V n*k,
+ * with the Sherman-Morrison-Woodbury identity: \n
+ * (A + U V^T)^-1 = IA - IA U (I + V^T IA U)^-1 V^T IA \n
+ * O(n*n*k), A is updated too so the result can be checked and refined against it
+ * @param A row major, updated in place
+ * @param IA column major, inverse of A, updated in place
+ * @param U, V k columns of A.size() elems
+ * @return false if I + V^T IA U is singular, the updated A is then too (or IA was not
+ * its inverse); A is updated anyway, IA is left untouched
+ */
+template<class AMatrix, class IAMatrix>
+bool woodbury_update(AMatrix& A, IAMatrix& IA, vector< varray<double> >& U, vector< varray<double> >& V){
+	ssize_t size = A.size();
+	size_t k = U.size();
+	ssize_t i, j, iv;
+	ssize_t vn = IA.vecN();
+	size_t a, b;
+	vector< varray<double> > Y(k), Z(k);
+	for(a = 0; a < k; ++a){
+		Y[a].alloc(size);
+		Z[a].alloc(size);
+	}
+	// Y = IA*U
+	multCols(IA, U, Y);
+	// Z = V^T*IA, dot of V columns with IA columns
+	for(a = 0; a < k; ++a){
+		for(j = 0; j < size; ++j){
+			vec<double> acc{0};
+			for(iv = 0; iv < V[a].sizeVec(); ++iv) // vect loop
+				acc.v += V[a].atv(iv).v * IA.atv(iv,j).v;
+			Z[a].at(j) = 0;
+			for(i = V[a].remStart(); i < size; ++i) // vect remainder
+				Z[a].at(j) += V[a].at(i) * IA.at(i,j);
+			for(ssize_t v = 0; v < vn; ++v) // vect result sum
+				Z[a].at(j) += acc[v];
+		}
+	}
+	// C = I + V^T*Y, k*k, inverted with the LU
+	Matrix<double> C(k), LU(k);
+	MatrixColMajor<double> I(k), IC(k);
+	varray<size_t> P(C.sizeMem());
+	for(a = 0; a < k; ++a){
+		for(b = 0; b < k; ++b){
+			C.at(a,b) = (a == b);
+			for(i = 0; i < size; ++i)
+				C.at(a,b) += V[a].at(i) * Y[b].at(i);
+		}
+	}
+	if(not GaussElChecked(C, LU, P)){
+		addUpdate(A, U, V);
+		return false;
+	}
+	assign(I, IdentityExpr<double>());
+	// k is small, the column by column solve doesn't touch the padding
+	GrowableArray<double> w(k);
+	for(a = 0; a < k; ++a)
+		solveLU(LU, IC, I, P, a, w);
+	// Z = C^-1 * Z, row by row of the k*n result
+	vector<double> t(k);
+	for(j = 0; j < size; ++j){
+		for(a = 0; a < k; ++a){
+			t[a] = 0;
+			for(b = 0; b < k; ++b)
+				t[a] += IC.at(a,b) * Z[b].at(j);
+		}
+		for(a = 0; a < k; ++a)
+			Z[a].at(j) = t[a];
+	}
+	// IA -= Y*Z, axpy on each IA column
+	for(j = 0; j < size; ++j){
+		for(a = 0; a < k; ++a){
+			vec<double> z;
+			for(ssize_t v = 0; v < vn; ++v) z[v] = Z[a].at(j);
+			for(iv = 0; iv < Y[a].sizeVec(); ++iv) // vect loop
+				IA.atv(iv,j).v -= Y[a].atv(iv).v * z.v;
+			for(i = Y[a].remStart(); i < size; ++i) // vect remainder
+				IA.at(i,j) -= Y[a].at(i) * Z[a].at(j);
+		}
+	}
+	addUpdate(A, U, V);
+	return true;
+}
+
+
+}
+#endif
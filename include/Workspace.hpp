@@ -0,0 +1,131 @@
+#ifndef WORKSPACE_H
+#define WORKSPACE_H
+
+#include <iostream>
+
+#include "Matrix.hpp"
+#include "Allocation.hpp"
+
+namespace gm {
+using namespace std;
+
+/**
+ * @brief Owns the scratch memory of the LU inversion and its refinement.
+ * Each buffer is allocated on first use to size(), and kept: inverting again
+ * a matrix of the same size allocates nothing. \n
+ * The matrices are mapped following the AllocPolicy given to reserve(). \n
+ * Buffers not needed by the method used (Newton-Schulz, estimates) are never allocated.
+ * They are zeroed when allocated: the substitutions go through the padding,
+ * which must stay finite and decoupled
+ * @param Elem elem type of the matrices inverted
+ */
+template<class Elem = double>
+class InverseWorkspace
+{
+	enum { vectors = 4 };
+
+	Placed<Elem> mLU, mX;
+	Placed<Elem, MatrixColMajor> mW, mR, mZ;
+	varray<Elem> mV[vectors];
+	// size each buffer was allocated to, 0 if not yet
+	size_t mSizeLU, mSizeW, mSizeR, mSizeZ, mSizeX, mSizeV[vectors];
+	size_t mSize;
+	AllocPolicy mPolicy;
+	size_t mAllocs; // allocations done, reallocations included
+
+	/** @brief Zeroes all of M, padding included */
+	template<class Mat>
+	static void zero(Mat& M){
+		for(size_t i = 0; i < M.sizeMem(); ++i)
+			for(size_t j = 0; j < M.sizeMem(); ++j)
+				M.at(i,j) = 0;
+	}
+	static void zero(varray<Elem>& v){
+		for(size_t i = 0; i < v.sizeMem(); ++i)
+			v.at(i) = 0;
+	}
+	/** @brief Mapped as the policy of reserve, zeroed */
+	template<template<class> class Mat>
+	void allocate(Placed<Elem, Mat>& M){
+		M.alloc(mSize, mPolicy);
+		// mapped pages come zeroed, and touching them here would undo the policy
+		if(not M.mapped())
+			zero(M);
+	}
+	void allocate(varray<Elem>& v){
+		v.alloc(mSize);
+		zero(v);
+	}
+	/** @brief Allocates M to size() if it isn't */
+	template<class Buffer>
+	Buffer& sized(Buffer& M, size_t& bufSize){
+		if(bufSize != mSize){
+			allocate(M);
+			bufSize = mSize;
+			++mAllocs;
+		}
+		return M;
+	}
+	template<class Buffer>
+	size_t bytesOf(Buffer& M, size_t bufSize) const {
+		return bufSize ? M.sizeMem()*M.sizeMem()*sizeof(Elem) : 0;
+	}
+public:
+	InverseWorkspace() : mSizeLU(0), mSizeW(0), mSizeR(0), mSizeZ(0), mSizeX(0),
+		mSize(0), mAllocs(0) {
+		for(size_t k = 0; k < vectors; ++k)
+			mSizeV[k] = 0;
+	}
+	InverseWorkspace(const InverseWorkspace&) = delete;
+	InverseWorkspace& operator=(const InverseWorkspace&) = delete;
+
+	/**
+	 * @brief Sets the size of the matrices inverted with it, O(1):
+	 * the buffers are reallocated on their next use only if size changed
+	 * @param policy how the matrices are mapped, see Placed
+	 */
+	void reserve(size_t size, const AllocPolicy& policy = AllocPolicy()){
+		mSize = size;
+		mPolicy = policy;
+	}
+	size_t size() const { return mSize; }
+
+	/** @brief LU decomposition */
+	Placed<Elem>& LU(){ return sized(mLU, mSizeLU); }
+	/** @brief Correction of the inverse */
+	MatrixColMajor<Elem>& W(){ return sized(mW, mSizeW); }
+	/** @brief Residue of the inverse */
+	MatrixColMajor<Elem>& R(){ return sized(mR, mSizeR); }
+	/** @brief Intermediate of the substitutions, L*Z = B */
+	MatrixColMajor<Elem>& Z(){ return sized(mZ, mSizeZ); }
+	/** @brief -IA in row major, left operand of Newton-Schulz */
+	Matrix<Elem>& X(){ return sized(mX, mSizeX); }
+	/** @brief Work vector k < 4, of the condition and residue estimates */
+	varray<Elem>& v(size_t k){
+		assert(k < vectors);
+		return sized(mV[k], mSizeV[k]);
+	}
+
+	/** @brief n of allocations done, unchanged while the size is */
+	size_t allocations() const { return mAllocs; }
+	/** @brief Memory held by the buffers allocated so far */
+	size_t bytes() const {
+		size_t total = bytesOf(mLU, mSizeLU) + bytesOf(mW, mSizeW) + bytesOf(mR, mSizeR)
+			+ bytesOf(mZ, mSizeZ) + bytesOf(mX, mSizeX);
+		for(size_t k = 0; k < vectors; ++k)
+			total += mSizeV[k] ? mV[k].sizeMem()*sizeof(Elem) : 0;
+		return total;
+	}
+};
+
+/**
+ * @brief Prints the footprint of ws in a line of comment, in KiB
+ */
+template<class Elem>
+void printWorkspace(const InverseWorkspace<Elem>& ws){
+	cout<<"# Workspace: "<< ws.bytes()/1024 <<" KiB, alocacoes "<< ws.allocations() <<"\n";
+}
+
+
+}
+#endif
@@ -3,16 +3,41 @@
 #include <fstream>
 #include <iomanip>
 #include <vector>
+#include <string>
+#include <sstream>
 #include <cmath>
 #include <ctgmath>
+#include <cfloat>
+#include <complex>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <queue>
+#include <functional>
+#include <cerrno>
 //#include <likwid.h>
 #include <unistd.h>
+#include <getopt.h>
 
 #include "Matrix.hpp"
 #include "GaussEl.hpp"
+#include "MatrixTiled.hpp"
+#include "Allocation.hpp"
+#include "Workspace.hpp"
+#include "Tuning.hpp"
 #include "Subst.hpp"
 #include "Chronometer.hpp"
 #include "SolveLU.hpp"
+#include "Condition.hpp"
+#include "BlockInverse.hpp"
+#include "Equilibrate.hpp"
+#include "Selected.hpp"
+#include "Update.hpp"
+#include "Bordered.hpp"
+#include "Structure.hpp"
+#include "Toeplitz.hpp"
+#include "Components.hpp"
+#include "Sparse.hpp"
 
 using namespace std;
 using namespace gm;
@@ -20,4 +45,213 @@ using namespace gm;
 #include "matrix_mult_test.hpp"
 #include "vector_test.hpp"
 
-void parseArgs(int& argc, char**& argv, bool& input, size_t& size, size_t& iter_n, ifstream& in_f, ofstream& o_f);
+/**
+ * @brief Options given in the command line
+ */
+struct Args {
+	bool input; // read matrix from cin, else generates a random one
+	size_t size; // size of the random matrix
+	size_t iter_n; // refining iterations
+	size_t probes; // random vectors per residue estimate, 0 to always calculate it
+	double tol; // residue norm considered converged
+	bool newton; // refine with Newton-Schulz iterations
+	bool block; // invert recursively by blocks
+	bool equilibrate; // scale rows and columns before inverting
+	bool diagOnly; // output only the diagonal of the inverse
+	vector<size_t> columns; // output only these columns of the inverse
+	const char* updateFile; // U and V of a low rank update of A
+	const char* inverseFile; // inverse of A to be updated
+	bool border; // invert growing the inverse of the leading block
+	long remove; // row and column removed after inverting, -1 for none
+	bool sequence; // input has many matrices, factored reusing the pivoting
+	bool dense; // skip the structure detection
+	bool toeplitz; // input is the generator of a Toeplitz matrix
+	bool sparse; // input is sparse, inverted with the sparse LU
+	bool det, logdet; // output only the determinant or its log, no inverse
+	bool tiled; // LU inversion on tiled matrices
+	AllocPolicy alloc; // how the LU memory is mapped
+	string precision; // elem type of the LU inversion: float, double, complex or complex-float
+	string isa; // instruction set of the kernels, empty for the profile's or the widest
+	bool tune; // benchmark the kernel parameters and save them to the profile
+	string profile; // kernel parameters of this host, loaded if it has the matrix size
+};
+
+/**
+ * @brief Refining of one matrix: the one of Args, or the one pickRefining chooses for it
+ */
+struct Refining {
+	size_t iter_n; // refining iterations
+	size_t probes; // random vectors per residue estimate, 0 to always calculate it
+	bool newton; // refine with Newton-Schulz iterations
+};
+
+/**
+ * @brief Reads the non negative integer written in the whole of s into x
+ * @return false if s is not one, x is left as is
+ */
+bool parseSize(const char* s, size_t& x);
+void parseArgs(int& argc, char**& argv, Args& args, ifstream& in_f, ofstream& o_f);
+/**
+ * @brief Sets the kernels up for Elem matrices of size: the parameters of the profile
+ * for its size bucket, if any, then the instruction set of args; prints them
+ */
+template<class Elem>
+void setupKernels(Args& args, size_t size);
+/**
+ * @brief Benchmarks on A (read or random, of Elem) the instruction set of the LU, then the
+ * unrolling and the L1 tile of the substitutions and of the residue; saves the fastest
+ * to the profile, for the size bucket of A
+ */
+template<class Elem>
+void tuneKernels(Args& args);
+/**
+ * @brief Tunes k, the parameters of the kernel run calls: the unrolling with the tile
+ * it had, then the tile with the best unrolling. Prints each time
+ * @return time of the best
+ */
+template<class Elem>
+double tuneKernel(KernelTuning& k, const char* name, size_t size, const function<void()>& run);
+/**
+ * @brief Best time of reps runs of run, after an untimed one bringing the matrices to the caches
+ */
+double timeBest(const function<void()>& run, size_t reps = 2);
+/**
+ * @brief Chooses refining iterations and strategy from the estimated condition number.
+ * Each iteration reduces the error by about cond*eps, well-conditioned matrices are not refined
+ * @param r starts as the one of Args, probes given are kept
+ * @param eps machine epsilon of the elems inverted
+ */
+void pickRefining(double cond, Refining& r, double eps = DBL_EPSILON);
+/**
+ * @brief Number of classic refining iterations, with substitutions, for the estimated condition
+ * number cond: the count pickRefining starts from, before it may switch to Newton-Schulz
+ * @param eps machine epsilon of the elems inverted
+ */
+size_t refiningIterations(double cond, double eps = DBL_EPSILON);
+/**
+ * @brief Number of Newton-Schulz iterations taking an inverse of residue err down to the
+ * rounding level, the larger of 1e3*eps and cond*eps: each one squares the residue
+ * @param err residue of the inverse, estimated; at least one iteration if it's 1 or more
+ */
+size_t newtonIterations(double err, double cond, double eps = DBL_EPSILON);
+/**
+ * @brief Inverts A into IA with the LU decomposition and refines it as args tell
+ */
+void invertLU(Matrix<double>& A, MatrixColMajor<double>& IA, Args& args);
+/**
+ * @param P pivoting, kept for the next matrices
+ * @param ws scratch of the inversion, its LU included; reused, nothing is allocated
+ * if it was already used for a matrix of this size
+ * @param reuseP factor in the row order of P without pivoting, unless a pivot is too small
+ */
+template<class Elem>
+void invertLU(Matrix<Elem>& A, MatrixColMajor<Elem>& IA, Args& args, varray<size_t>& P, bool reuseP,
+InverseWorkspace<Elem>& ws);
+/**
+ * @brief Inverts A into IA as invertLU, with A, LU and IA copied into MatrixTiled
+ * @return true, the inverse is always found
+ */
+bool invertTiled(Matrix<double>& A, MatrixColMajor<double>& IA, Args& args, varray<size_t>& P,
+InverseWorkspace<>& ws);
+/**
+ * @brief Refines the inverse from the factored LU as args tell: the number of iterations
+ * from the condition estimate if not given, Newton-Schulz or substitutions, then prints the times
+ */
+template<class AMatrix, class LUMatrix, class IAMatrix, class Elem>
+void refineLU(AMatrix& A, LUMatrix& LU, IAMatrix& IA, Args& args, varray<size_t>& P,
+InverseWorkspace<Elem>& ws);
+/**
+ * @brief Reads or generates the matrices as Elem, complex ones as (re,im), and inverts them
+ * with the LU decomposition: the precision args asks for other than double
+ */
+template<class Elem>
+void invertAs(Args& args);
+/**
+ * @brief Inverts A into IA recursively by blocks, refines with Newton-Schulz
+ * @return false if the result is not accurate enough to be refined
+ */
+bool invertBlock(Matrix<double>& A, MatrixColMajor<double>& IA, Args& args);
+/**
+ * @brief Calculates and prints only the diagonal or the columns of the inverse args asks for
+ * @param Rs, Cs equilibration scales, if args.equilibrate
+ */
+void invertSelected(Matrix<double>& A, Args& args, varray<double>& Rs, varray<double>& Cs);
+/**
+ * @brief Inverts A + U*V^T into IA updating the inverse of A, U and V read from args.updateFile.
+ * A is updated too; the result is refined with Newton-Schulz, -i times or as its condition asks
+ * @param Rs, Cs equilibration scales, if args.equilibrate: U and V are scaled too
+ * @return false if the update is singular or not accurate enough to be refined, A is updated anyway
+ */
+bool invertUpdate(Matrix<double>& A, MatrixColMajor<double>& IA, Args& args,
+varray<double>& Rs, varray<double>& Cs);
+/**
+ * @brief Reads IA from a file in the output format, report lines are skipped
+ */
+bool readInverse(MatrixColMajor<double>& IA, const char* file);
+/**
+ * @brief Inverts A into IA by bordering, O(n*n) per added row and column.
+ * Without -i no O(n*n*n) step is done, the accuracy is estimated
+ * @return false if a leading block is singular or the result is not accurate
+ */
+bool invertBordered(Matrix<double>& A, Growable<double, MatrixColMajor>& IA, Args& args);
+/**
+ * @brief Inverts A into IA with the method for its structure: diagonal, triangular,
+ * tridiagonal or banded, with the bandwidths found in O(n*n)
+ * @return false if A is dense or the result is not accurate
+ */
+bool invertStructured(Matrix<double>& A, MatrixColMajor<double>& IA, Args& args);
+/**
+ * @brief Inverts a Toeplitz A into IA in O(n*n) with Levinson and Gohberg-Semencul,
+ * a circulant one with the FFT
+ * @return false if A isn't Toeplitz, Levinson breaks down or the result is not accurate
+ */
+bool invertToeplitz(Matrix<double>& A, MatrixColMajor<double>& IA, Args& args);
+/**
+ * @brief Inverts the Toeplitz T into IA from its generator, O(n*n) without forming T
+ * @return false if Levinson breaks down or the result is not accurate
+ */
+bool invertToeplitz(ToeplitzMatrix& T, MatrixColMajor<double>& IA);
+/**
+ * @brief Reads or generates the generators of Toeplitz matrices and inverts them from it,
+ * the n*n matrix is only formed if the LU decomposition has to invert it
+ */
+void invertGenerator(Args& args);
+/**
+ * @brief Inverts A into IA by the connected components of its nonzero pattern,
+ * each diagonal block on its own and in parallel
+ * @return false if A has a single component or a singular block
+ */
+bool invertComponents(Matrix<double>& A, MatrixColMajor<double>& IA, Args& args);
+/**
+ * @brief Prints the determinant of A (or its log, as args asks) from the LU, without inverting
+ * @param Rs, Cs equilibration scales, if args.equilibrate
+ */
+void determinant(Matrix<double>& A, Args& args, varray<double>& Rs, varray<double>& Cs);
+/**
+ * @brief Prints sign*exp(logDet), or sign and logDet with args.logdet
+ */
+void printDeterminant(double logDet, int sign, Args& args);
+/**
+ * @brief Reads a sparse A, factors it with SparseLU and prints the inverse, its diagonal
+ * or the columns args asks for; each column is a sparse solve refined with the sparse residue
+ */
+void invertSparse(Args& args);
+/**
+ * @brief Estimates the residue of IA in O(n*n) and refines it with Newton-Schulz if iter_n > 0
+ * @param label printed with the residue
+ * @return false if IA is too inaccurate to be refined
+ */
+bool checkInverse(Matrix<double>& A, MatrixColMajor<double>& IA, long iter_n, const char* label);
+/**
+ * @brief Estimates the residue of IA in O(n*n) and prints it, A may be given by a generator
+ * @param label printed with the residue
+ * @return false if IA is too inaccurate to be refined
+ */
+template<class AMatrix>
+bool estimateInverse(AMatrix& A, MatrixColMajor<double>& IA, const char* label);
+/**
+ * @brief Removes row and column args.remove from A and from its inverse IA in O(n*n)
+ * @param Rs, Cs equilibration scales, if args.equilibrate the index is removed from them too
+ */
+void removeIndex(Growable<double>& A, Growable<double, MatrixColMajor>& IA, Args& args,
+GrowableArray<double>& Rs, GrowableArray<double>& Cs);
@@ -106,7 +106,7 @@ void t_matrix_mult(size_t size){
 			vec<double> acc;
 			vect(v) acc[v] = 0;
 			//memset(acc.v, 0, sizeof(acc.v));
-			for (kv = bk[0]/4; k < kmax/4; ++kv)
+			for (kv = bk[0]/4; kv < kmax/4; ++kv)
 				acc.v = acc.v - LU.atv(i, kv).v * B.atv(kv, j).v;
 			for(k = kv*4; k < kmax; ++k)
 				X.at(i, j) = X.at(i, j) - LU.at(i, k) * B.at(k, j);
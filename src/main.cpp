@@ -2,7 +2,52 @@
 @mainpage
 
 Inverts input matrix using LU decomposition by Gauss Elimination and refining
-Usage: %s [-e inputFile] [-o outputFile] [-r randSize] -i Iterations
+Usage: %s [-e inputFile] [-o outputFile] [-r randSize] [-s Probes] [-t Tolerance] [-n] [-b] [-q] [--diag-only | --columns c0,c1,...] [--update UVFile] [--inverse IAFile] [--border] [--remove k] [--sequence] [--dense] [--toeplitz] [--sparse] [--det | --logdet] [--tiled] [--alloc p0,p1,...] [--precision float|double|complex|complex-float] [--isa generic|avx2|avx512] [--cache L1,L2,L3] [--tile b] [--tune] [--profile file] [-i Iterations]
+
+--update inverts A + U*V^T updating the inverse of A (Sherman-Morrison-Woodbury),
+  UVFile has k, then the n*k U and the n*k V
+--inverse reads the inverse of A from IAFile (a previous output) instead of calculating it
+--border inverts by bordering, growing the inverse of the leading block one row and column at a time
+--remove outputs the inverse of A without row and column k, updated from the inverse of A
+--sequence inverts every matrix in the input, one after the other, factoring them
+  in the row order of the previous pivoting while its pivots stay large enough
+--dense skips the structure detection: diagonal, triangular, tridiagonal and banded
+  matrices are otherwise inverted with their own O(n*n*b) methods, Toeplitz ones
+  with Levinson in O(n*n) and circulant ones with the FFT
+--toeplitz reads only the generator of a Toeplitz matrix: n, the first column and
+  the first row without its first elem; with -r generates a random Toeplitz one.
+  It is inverted from the generator, the n*n matrix is only formed for -i, for the
+  options that need it or when the LU decomposition has to invert it
+Unless --dense, a matrix whose nonzeros split into independent (permuted) diagonal
+  blocks has each block inverted on its own, in parallel
+--sparse reads n, the number of nonzeros and a line "i j value" for each (0 based),
+  factors with a fill reducing order and a sparse LU and solves each column;
+  works with --diag-only, --columns and --sequence (same nonzero pattern)
+--det outputs only the determinant, --logdet its sign and the log of its absolute value
+  (which doesn't overflow), both from the LU without inverting; 0 (0 -inf) if it is singular.
+  With --sequence, of every matrix
+--tiled stores the matrices of the LU inversion in contiguous 32x32 tiles
+--alloc maps the LU and the matrices of the refining with the given policies: huge (2 MiB
+  pages), interleave (over the NUMA nodes), populate (pages faulted in up front), touch
+  (first touched by all threads)
+--precision inverts with the LU decomposition in float, double (the default),
+  complex<double> or complex<float> elems; complex input elems are written (re,im)
+--isa runs the LU, substitution and residue kernels compiled for the given instruction
+  set instead of the widest one the CPU supports
+--cache tiles the kernels for L1, L2 and L3 caches of the given KiB instead of the ones
+  read from /sys/devices/system/cpu/cpu0/cache, --tile sets the side of their L1 tiles
+  directly, the L2 and L3 tiles are multiples of it
+--tune benchmarks the instruction set of the LU, then the unrolling and the L1 tile of
+  the substitutions and of the residue on the input (or random) matrix, and saves the
+  fastest to the profile for its size bucket (powers of 2), without inverting
+--profile kernel parameters loaded when it has an entry for the size bucket of the
+  input, ~/.invmat-<hostname>.profile by default
+--diag-only outputs only the diagonal of the inverse
+--columns outputs only the given columns of the inverse (0 based)
+-q equilibrates rows and columns of the input before inverting
+-b inverts recursively by blocks (Schur complement), refined by Newton-Schulz
+-n refines with Newton-Schulz iterations (matrix multiplications only)
+Without -i the iterations are chosen from the estimated condition number of the input
 
 @authors Bruno Freitas Serbena
 @authors Luiz Gustavo Jhon Rodrigues
@@ -15,14 +60,112 @@ Usage: %s [-e inputFile] [-o outputFile] [-r randSize] -i Iterations
  * @param A needs to have been allocated
  */
 template <class Mat>
-void readMatrix(Mat& A){
+void readMatrix(Mat& A, istream& in = cin){
 	for(long i=0; i < A.size(); i++){
 		for(long j=0; j < A.size(); j++){
-			cin>> A.at(i,j);
+			in>> A.at(i,j);
 		}
 	}
 }
 
+/**
+ * @brief Assigns the generator of a Toeplitz matrix in cin to col and row:
+ * the first column, then the first row without its first elem
+ * @param col, row need to have been allocated
+ */
+void readGenerator(varray<double>& col, varray<double>& row, istream& in = cin){
+	for(size_t k = 0; k < col.size(); k++)
+		in>> col.at(k);
+	row.at(0) = col.at(0);
+	for(size_t k = 1; k < row.size(); k++)
+		in>> row.at(k);
+}
+
+/**
+ * @brief Assigns a random generator of a Toeplitz matrix to col and row
+ */
+void randomGenerator(varray<double>& col, varray<double>& row){
+	double invRandMax = 1.0/(double)RAND_MAX;
+	for(size_t k = 0; k < col.size(); ++k){
+		col.at(k) = (double)rand() * invRandMax;
+		row.at(k) = (double)rand() * invRandMax;
+	}
+	row.at(0) = col.at(0);
+}
+
+/**
+ * @brief Assigns the Toeplitz matrix from its generator in cin to A, see readGenerator
+ * @param A needs to have been allocated
+ */
+template <class Mat>
+void readToeplitz(Mat& A, istream& in = cin){
+	size_t size = A.size();
+	varray<double> col(size), row(size);
+	readGenerator(col, row, in);
+	toeplitzMatrix(A, col, row);
+}
+
+/**
+ * @brief Assigns the sparse matrix in cin to A: its number of nonzeros,
+ * then a line "i j value" for each of them (0 based)
+ * @param size number of rows/columns, already read
+ * @return false if the input ended
+ */
+bool readSparse(SparseMatrix& A, size_t size, istream& in = cin){
+	size_t nnz = 0;
+	in>> nnz;
+	vector<size_t> I(nnz), J(nnz);
+	vector<double> V(nnz);
+	for(size_t k = 0; k < nnz; k++){
+		in>> I[k] >> J[k] >> V[k];
+		if(I[k] >= size || J[k] >= size){
+			fprintf(stderr, "Nonzero (%zu,%zu) out of the matrix\n", I[k], J[k]);
+			exit(EXIT_FAILURE);
+		}
+	}
+	A.fromTriplets(size, I, J, V);
+	return (bool)in;
+}
+
+/**
+ * @brief Assigns the next sparse matrix of a sequence in cin to A,
+ * exits if it is not of the size of A
+ * @return false if the input ended
+ */
+bool readNextSparse(SparseMatrix& A, istream& in = cin){
+	size_t size;
+	if(not (in>> size))
+		return false;
+	if(size != A.size()){
+		fprintf(stderr, "Matrices of the sequence must be %zux%zu\n", A.size(), A.size());
+		exit(EXIT_FAILURE);
+	}
+	return readSparse(A, size, in);
+}
+
+/**
+ * @brief Assigns the next matrix of a sequence in cin to A (its generator with --toeplitz),
+ * equilibrated with Rs and Cs if args asks; exits if it is not of the size of A
+ * @return false if the input ended
+ */
+bool readNextMatrix(Matrix<double>& A, Args& args, varray<double>& Rs, varray<double>& Cs,
+istream& in = cin){
+	size_t size;
+	if(not (in>> size))
+		return false;
+	if(size != A.size()){
+		fprintf(stderr, "Matrices of the sequence must be %zux%zu\n", A.size(), A.size());
+		exit(EXIT_FAILURE);
+	}
+	if(args.toeplitz)
+		readToeplitz(A, in);
+	else
+		readMatrix(A, in);
+	if(args.equilibrate)
+		equilibrate(A, Rs, Cs);
+	return true;
+}
+
 int main(int argc, char **argv) {
 	//LIKWID_MARKER_INIT;
 	cout.precision(8);
@@ -33,59 +176,901 @@ int main(int argc, char **argv) {
 	ofstream o_f;
 	streambuf* coutbuf = cout.rdbuf(); //save old buf;
 	
-	bool input;
-	size_t size, iter_n;
+	Args args;
 	// redirects cout & cin
-	parseArgs(argc, argv, input, size, iter_n, in_f, o_f);
+	parseArgs(argc, argv, args, in_f, o_f);
+	size_t size = args.size;
+	
+	if(args.tune){
+		if(args.precision == "float")
+			tuneKernels<float>(args);
+		else if(args.precision == "complex")
+			tuneKernels< complex<double> >(args);
+		else if(args.precision == "complex-float")
+			tuneKernels< complex<float> >(args);
+		else
+			tuneKernels<double>(args);
+		in_f.close();
+		cout.rdbuf(coutbuf); //redirect
+		o_f.close();
+		return 0;
+	}
+	if(args.sparse){
+		setupKernels<double>(args, 0);
+		invertSparse(args);
+		in_f.close();
+		cout.rdbuf(coutbuf); //redirect
+		o_f.close();
+		return 0;
+	}
+	if(args.precision != "double"){
+		if(args.precision == "float")
+			invertAs<float>(args);
+		else if(args.precision == "complex")
+			invertAs< complex<double> >(args);
+		else
+			invertAs< complex<float> >(args);
+		in_f.close();
+		cout.rdbuf(coutbuf); //redirect
+		o_f.close();
+		return 0;
+	}
+	
+	// options that need the n*n matrix, not only its generator
+	bool needsMatrix = args.equilibrate || args.det || args.logdet || args.diagOnly
+		|| not args.columns.empty() || args.updateFile || args.inverseFile || args.border
+		|| args.remove != -1 || args.block || args.tiled || args.dense
+		|| (args.iter_n > 0 && args.iter_n != -1);
+	if(args.toeplitz && not needsMatrix){
+		invertGenerator(args);
+		in_f.close();
+		cout.rdbuf(coutbuf); //redirect
+		o_f.close();
+		return 0;
+	}
 	
-	Matrix<double> A;
+	Growable<double> A;
 	
-	if(input){
+	if(args.input){
 		cin>> size;
+		args.size = size;
 		A.alloc(size);
-		readMatrix(A);
-		in_f.close();
+		if(args.toeplitz)
+			readToeplitz(A);
+		else
+			readMatrix(A);
+		if(not args.sequence)
+			in_f.close();
 	}else {
 		A.alloc(size);
-		randomMatrix(A);
+		if(args.toeplitz){
+			varray<double> col(size), row(size);
+			randomGenerator(col, row);
+			toeplitzMatrix(A, col, row);
+		} else {
+			randomMatrix(A);
+		}
 	}
+	setupKernels<double>(args, size);
 	
-	Matrix<double> LU(size);
+	GrowableArray<double> Rs, Cs;
+	if(args.equilibrate){
+		Rs.alloc(size); Cs.alloc(size);
+		equilibrate(A, Rs, Cs);
+	}
+	
+	if(args.remove != -1 && args.remove >= size){
+		fprintf(stderr, "Row and column %ld out of the matrix\n", args.remove);
+		exit(EXIT_FAILURE);
+	}
+	for(size_t c = 0; c < args.columns.size(); ++c){
+		if(args.columns[c] >= size){
+			fprintf(stderr, "Column %zu out of the matrix\n", args.columns[c]);
+			exit(EXIT_FAILURE);
+		}
+	}
+	if(args.det || args.logdet){
+		do
+			determinant(A, args, Rs, Cs);
+		while(args.sequence && readNextMatrix(A, args, Rs, Cs));
+		in_f.close();
+		cout.rdbuf(coutbuf); //redirect
+		o_f.close();
+		return 0;
+	}
+	if(args.diagOnly || not args.columns.empty()){
+		invertSelected(A, args, Rs, Cs);
+		in_f.close();
+		cout.rdbuf(coutbuf); //redirect
+		o_f.close();
+		return 0;
+	}
+	
+	Growable<double, MatrixColMajor> IA(size);
 	varray<size_t> P(A.sizeMem());
+	// scratch of the LU inversions, kept for the next matrices of the sequence
+	InverseWorkspace<> ws;
+	ws.reserve(size, args.alloc);
+	
+	bool inverted = false;
+	if(args.updateFile)
+		inverted = invertUpdate(A, IA, args, Rs, Cs);
+	else if(args.inverseFile)
+		inverted = readInverse(IA, args.inverseFile);
+	if(not args.dense && not inverted)
+		inverted = invertStructured(A, IA, args);
+	if(not args.dense && not inverted)
+		inverted = invertToeplitz(A, IA, args);
+	if(not args.dense && not inverted)
+		inverted = invertComponents(A, IA, args);
+	if(args.border && not inverted)
+		inverted = invertBordered(A, IA, args);
+	if(args.block && not inverted)
+		inverted = invertBlock(A, IA, args);
+	if(args.tiled && not inverted)
+		inverted = invertTiled(A, IA, args, P, ws);
+	if(not inverted)
+		invertLU(A, IA, args, P, false, ws);
+	if(args.remove != -1)
+		removeIndex(A, IA, args, Rs, Cs);
+	if(args.equilibrate)
+		unequilibrate(IA, Rs, Cs);
+	cout<<"#\n";
+	printm(IA);
+	
+	// next matrices of the sequence reuse the pivoting of the last one factored
+	bool pivoted = not inverted;
+	while(args.sequence && readNextMatrix(A, args, Rs, Cs)){
+		cout<< scientific;
+		total_time_iter = total_time_residue = 0;
+		invertLU(A, IA, args, P, pivoted, ws);
+		pivoted = true;
+		if(args.equilibrate)
+			unequilibrate(IA, Rs, Cs);
+		cout<<"#\n";
+		printm(IA);
+	}
+	
+	//LIKWID_MARKER_CLOSE;
+	in_f.close();
+	cout.rdbuf(coutbuf); //redirect
+	o_f.close();
+	return 0;
+}
+
+void invertLU(Matrix<double>& A, MatrixColMajor<double>& IA, Args& args){
+	varray<size_t> P(A.sizeMem());
+	InverseWorkspace<> ws;
+	ws.reserve(A.size(), args.alloc);
+	invertLU(A, IA, args, P, false, ws);
+}
+
+template<class Elem>
+void invertLU(Matrix<Elem>& A, MatrixColMajor<Elem>& IA, Args& args, varray<size_t>& P, bool reuseP,
+InverseWorkspace<Elem>& ws){
+	// pivots this small relative to their column make the static order unstable
+	const double pivotTol = 1e-3;
+	Placed<Elem>& LU = ws.LU();
 	
 	timer.start();
 	//LIKWID_MARKER_START("LU");
 	
-	GaussEl(A, LU, P);
+	bool factored = reuseP && GaussElStatic(A, LU, P, pivotTol, ws.v(0));
+	if(reuseP && not factored)
+		cout<<"# Pivo pequeno, refazendo o pivoteamento\n";
+	if(not factored)
+		GaussEl(A, LU, P);
 	
 	//LIKWID_MARKER_STOP("LU");
 	lu_time = timer.tick();
+	if(args.alloc.any())
+		printAllocStats("LU", LU.allocStats());
 	
-	MatrixColMajor<double> IA(size);
+	refineLU(A, LU, IA, args, P, ws);
+}
+
+bool invertTiled(Matrix<double>& A, MatrixColMajor<double>& IA, Args& args, varray<size_t>& P,
+InverseWorkspace<>& ws){
+	size_t size = A.size();
+	MatrixTiled<double> At(size), LU(size);
+	MatrixTiledColMajor<double> IAt(size);
+	for(size_t i = 0; i < size; ++i)
+		for(size_t j = 0; j < size; ++j)
+			At.at(i,j) = A.at(i,j);
+	
+	timer.start();
+	GaussEl(At, LU, P);
+	lu_time = timer.tick();
+	
+	refineLU(At, LU, IAt, args, P, ws);
+	for(size_t j = 0; j < size; ++j)
+		for(size_t i = 0; i < size; ++i)
+			IA.at(i,j) = IAt.at(i,j);
+	return true;
+}
+
+template<class AMatrix, class LUMatrix, class IAMatrix, class Elem>
+void refineLU(AMatrix& A, LUMatrix& LU, IAMatrix& IA, Args& args, varray<size_t>& P,
+InverseWorkspace<Elem>& ws){
+	double cond = cond1Estimate(A, LU, P, ws.v(0), ws.v(1), ws.v(2), ws.v(3));
+	cout<<"# Condicionamento estimado: "<< cond <<"\n";
+	// picked for this matrix only, args keeps what the user gave for the next ones
+	Refining picked = { args.iter_n, args.probes, args.newton };
+	if(args.iter_n == -1)
+		pickRefining(cond, picked, numeric_limits<typename RealOf<Elem>::type>::epsilon());
+	size_t iter_n = picked.iter_n;
 	
 	cout<<"#\n";
-	inverse_refining(A, LU, IA, P, iter_n);
+	// iterations done, the estimate and Newton-Schulz may stop before iter_n
+	long done = -1;
+	if(picked.newton){
+		done = inverse_newton_schulz(A, LU, IA, P, iter_n, ws);
+		if(done < 0)
+			fprintf(stderr, "Residue too large for Newton-Schulz, refining with substitutions\n");
+	}
+	if(done < 0){
+		if(picked.probes)
+			done = inverse_refining_estimate(A, LU, IA, P, iter_n, picked.probes, args.tol, ws);
+		else {
+			inverse_refining(A, LU, IA, P, iter_n, ws);
+			done = iter_n;
+		}
+	}
 
 	cout<< defaultfloat;
 	cout<<"# Tempo LU: "<< lu_time <<"\n";
-	cout<<"# Tempo iter: "<< total_time_iter/(double)iter_n <<"\n";
-	cout<<"# Tempo residuo: "<< total_time_residue/(double)iter_n <<"\n#\n";
+	if(done > 0){
+		cout<<"# Tempo iter: "<< total_time_iter/(double)done <<"\n";
+		cout<<"# Tempo residuo: "<< total_time_residue/(double)done <<"\n";
+	}
+	printWorkspace(ws);
+}
+
+template<class Elem>
+void invertAs(Args& args){
+	size_t size = args.size;
+	Matrix<Elem> A;
+	if(args.input){
+		cin>> size;
+		args.size = size;
+		A.alloc(size);
+		readMatrix(A);
+	} else {
+		A.alloc(size);
+		for(size_t i = 0; i < size; ++i)
+			for(size_t j = 0; j < size; ++j)
+				A.at(i,j) = randomElem<Elem>();
+	}
+	setupKernels<Elem>(args, size);
+	cout<<"# Precisao: "<< elemName<Elem>() <<"\n";
+	
+	MatrixColMajor<Elem> IA(size);
+	varray<size_t> P(A.sizeMem());
+	InverseWorkspace<Elem> ws;
+	ws.reserve(size, args.alloc);
+	invertLU(A, IA, args, P, false, ws);
+	cout<<"#\n";
 	printm(IA);
 	
-	//LIKWID_MARKER_CLOSE;
-	in_f.close();
-	cout.rdbuf(coutbuf); //redirect
-	o_f.close();
-	return 0;
+	bool pivoted = true;
+	while(args.sequence && cin>> size){
+		if(size != A.size()){
+			fprintf(stderr, "Matrices of the sequence must be %zux%zu\n", A.size(), A.size());
+			exit(EXIT_FAILURE);
+		}
+		readMatrix(A);
+		cout<< scientific;
+		total_time_iter = total_time_residue = 0;
+		invertLU(A, IA, args, P, pivoted, ws);
+		cout<<"#\n";
+		printm(IA);
+	}
+}
+
+bool invertBlock(Matrix<double>& A, MatrixColMajor<double>& IA, Args& args){
+	// Newton-Schulz stops by itself once converged
+	const size_t defaultIter = 4;
+	// multiplications below this size aren't worth the recursion
+	const size_t crossover = 8*tileL1<double>();
+	
+	timer.start();
+	if(not inverse_block(A, IA, crossover)){
+		fprintf(stderr, "Block inverse found a singular block, inverting with the LU decomposition\n");
+		return false;
+	}
+	double block_time = timer.tick();
+	
+	cout<<"#\n";
+	size_t iter_n = args.iter_n == -1 ? defaultIter : args.iter_n;
+	long done = refine_newton_schulz(A, IA, iter_n);
+	if(done < 0){
+		fprintf(stderr, "Block inverse is not accurate, inverting with the LU decomposition\n");
+		total_time_iter = total_time_residue = 0;
+		return false;
+	}
+	cout<< defaultfloat;
+	cout<<"# Tempo blocos: "<< block_time <<"\n";
+	if(done > 0){
+		cout<<"# Tempo iter: "<< total_time_iter/(double)done <<"\n";
+		cout<<"# Tempo residuo: "<< total_time_residue/(double)done <<"\n";
+	}
+	return true;
 }
 
-void parseArgs(int& argc, char**& argv,
-bool& input, size_t& size, size_t& iter_n, ifstream& in_f, ofstream& o_f){
+void invertSelected(Matrix<double>& A, Args& args, varray<double>& Rs, varray<double>& Cs){
+	size_t size = A.size();
+	// zeroed LU, the substitutions of inverse_columns go through its padding
+	InverseWorkspace<> ws;
+	ws.reserve(size);
+	Matrix<double>& LU = ws.LU();
+	varray<size_t> P(A.sizeMem());
+	
+	timer.start();
+	GaussEl(A, LU, P);
+	lu_time = timer.tick();
+	
+	if(args.diagOnly){
+		varray<double> D(size);
+		inverse_diagonal(LU, P, D);
+		if(args.equilibrate)
+			for(size_t j = 0; j < size; ++j)
+				D.at(j) *= Cs.at(j) * Rs.at(j);
+		cout<< defaultfloat;
+		cout<<"# Tempo LU: "<< lu_time <<"\n";
+		cout<<"#\n";
+		cout<< size <<"\n";
+		printv(D);
+		cout<<"\n";
+		return;
+	}
+	
+	vector<size_t>& cols = args.columns;
+	MatrixRectColMajor<double> X(size, cols.size());
+	// inverse_columns refines with substitutions only, no Newton-Schulz
+	long iter_n = args.iter_n;
+	if(iter_n == -1){
+		iter_n = refiningIterations(cond1Estimate(A, LU, P));
+		cout<<"# Iteracoes: "<< iter_n <<"\n";
+	}
+	cout<<"#\n";
+	inverse_columns(A, LU, P, cols, X, iter_n);
+	if(args.equilibrate)
+		for(size_t c = 0; c < cols.size(); ++c)
+			for(size_t i = 0; i < size; ++i)
+				X.at(i,c) *= Cs.at(i) * Rs.at(cols[c]);
+	
+	cout<< defaultfloat;
+	cout<<"# Tempo LU: "<< lu_time <<"\n";
+	cout<<"# Colunas:";
+	for(size_t c = 0; c < cols.size(); ++c)
+		cout<<" "<< cols[c];
+	cout<<"\n#\n";
+	cout<< size <<" "<< cols.size() <<"\n";
+	for(size_t i = 0; i < size; ++i){
+		for(size_t c = 0; c < cols.size(); ++c)
+			cout<< X.at(i,c) <<" ";
+		cout<<"\n";
+	}
+}
+
+bool invertUpdate(Matrix<double>& A, MatrixColMajor<double>& IA, Args& args,
+varray<double>& Rs, varray<double>& Cs){
+	size_t size = A.size(), k;
+	long iter_n = args.iter_n;
+	ifstream uv_f(args.updateFile);
+	uv_f>> k;
+	vector< varray<double> > U(k), V(k);
+	for(size_t c = 0; c < k; ++c){
+		U[c].alloc(size);
+		V[c].alloc(size);
+	}
+	for(size_t i = 0; i < size; ++i)
+		for(size_t c = 0; c < k; ++c)
+			uv_f>> U[c].at(i);
+	for(size_t i = 0; i < size; ++i)
+		for(size_t c = 0; c < k; ++c)
+			uv_f>> V[c].at(i);
+	if(not uv_f){
+		fprintf(stderr, "Could not read %zu update columns from %s\n", k, args.updateFile);
+		exit(EXIT_FAILURE);
+	}
+	// A is equilibrated already, the update must be too
+	if(args.equilibrate)
+		equilibrateUpdate(U, V, Rs, Cs);
+	
+	if(args.inverseFile)
+		readInverse(IA, args.inverseFile);
+	else
+		invertLU(A, IA, args);
+	
+	timer.start();
+	bool updated = woodbury_update(A, IA, U, V);
+	double update_time = timer.tick();
+	if(not updated){
+		fprintf(stderr, "Update capacitance matrix is singular, inverting with the LU decomposition\n");
+		return false;
+	}
+	
+	// O(n*n) accuracy check, the full residue is O(n*n*n)
+	varray<double> X(size), Y(size), Z(size);
+	cout<< scientific;
+	double err = residueEstimate(A, IA, 4, X, Y, Z);
+	cout<<"# Atualizacao posto "<< k <<", residuo estimado: "<< err <<"\n";
+	if(iter_n == -1){
+		// from the residue of the updated inverse: it has the rounding of the update
+		// and that of IA, which is only as accurate as the file it was read from
+		double cond = norm1(A) * norm1(IA);
+		cout<<"# Condicionamento estimado: "<< cond <<"\n";
+		iter_n = newtonIterations(err, cond);
+		cout<<"# Iteracoes: "<< iter_n <<"\n";
+	}
+	if(iter_n > 0){
+		total_time_iter = total_time_residue = 0;
+		if(refine_newton_schulz(A, IA, iter_n) < 0){
+			fprintf(stderr, "Updated inverse is not accurate enough to be refined, inverting with the LU decomposition\n");
+			return false;
+		}
+	}
+	cout<< defaultfloat;
+	cout<<"# Tempo atualizacao: "<< update_time <<"\n";
+	return true;
+}
+
+bool readInverse(MatrixColMajor<double>& IA, const char* file){
+	ifstream ia_f(file);
+	size_t size = 0;
+	string line;
+	while(ia_f>> ws && ia_f.peek() == '#') // skip the report lines of a previous run
+		getline(ia_f, line);
+	ia_f>> size;
+	if(size != IA.size()){
+		fprintf(stderr, "Inverse in %s is not %zux%zu\n", file, IA.size(), IA.size());
+		exit(EXIT_FAILURE);
+	}
+	readMatrix(IA, ia_f);
+	return true;
+}
+
+bool invertBordered(Matrix<double>& A, Growable<double, MatrixColMajor>& IA, Args& args){
+	size_t size = A.size();
+	long iter_n = args.iter_n;
+	
+	timer.start();
+	// grows the inverse of the leading block of A one row and column at a time
+	IA.resize(1);
+	IA.at(0,0) = 1/A.at(0,0);
+	bool singular = A.at(0,0) == 0;
+	for(size_t m = 1; m < size && not singular; ++m){
+		varray<double> u(m), v(m);
+		for(size_t i = 0; i < m; ++i){
+			u.at(i) = A.at(i,m);
+			v.at(i) = A.at(m,i);
+		}
+		singular = not border_append(IA, u, v, A.at(m,m));
+	}
+	double border_time = timer.tick();
+	if(singular){
+		fprintf(stderr, "A leading block is singular, inverting with the LU decomposition\n");
+		IA.resize(size);
+		return false;
+	}
+	
+	// no pivoting, check the accuracy
+	if(not checkInverse(A, IA, iter_n, "Bordejamento"))
+		return false;
+	cout<<"# Tempo bordejamento: "<< border_time <<"\n";
+	return true;
+}
+
+bool invertStructured(Matrix<double>& A, MatrixColMajor<double>& IA, Args& args){
+	size_t size = A.size(), lower, upper;
+	
+	timer.start();
+	bandwidths(A, lower, upper);
+	string kind;
+	bool inverted;
+	if(lower == 0 || upper == 0){
+		kind = lower == upper ? "diagonal" : "triangular";
+		inverted = inverse_triangular(A, IA, lower, upper);
+	} else if(lower == 1 && upper == 1 && inverse_tridiagonal(A, IA)){
+		kind = "tridiagonal";
+		inverted = true;
+	} else if(4*(lower + upper + 1) <= size){
+		kind = "banda";
+		inverted = inverse_banded(A, IA, lower, upper);
+	} else {
+		return false; // dense
+	}
+	double structure_time = timer.tick();
+	if(not inverted){
+		fprintf(stderr, "Singular %s matrix\n", kind.c_str());
+		exit(EXIT_FAILURE);
+	}
+	
+	cout<<"# Estrutura "<< kind <<", bandas "<< lower <<" "<< upper <<"\n";
+	if(not checkInverse(A, IA, args.iter_n, "Estrutura"))
+		return false;
+	cout<<"# Tempo estrutura: "<< structure_time <<"\n";
+	return true;
+}
+
+bool invertToeplitz(Matrix<double>& A, MatrixColMajor<double>& IA, Args& args){
+	size_t size = A.size();
+	
+	if(not isToeplitz(A))
+		return false;
+	varray<double> col(size), row(size);
+	for(size_t k = 0; k < size; ++k){
+		col.at(k) = A.at(k,0);
+		row.at(k) = A.at(0,k);
+	}
+	ToeplitzMatrix T(col, row);
+	if(not invertToeplitz(T, IA))
+		return false;
+	if(args.iter_n > 0 && args.iter_n != -1){
+		total_time_iter = total_time_residue = 0;
+		cout<< scientific;
+		refine_newton_schulz(A, IA, args.iter_n);
+		cout<< defaultfloat;
+	}
+	return true;
+}
+
+bool invertToeplitz(ToeplitzMatrix& T, MatrixColMajor<double>& IA){
+	timer.start();
+	bool circulant = isCirculant(T);
+	const char* kind = circulant ? "Circulante" : "Toeplitz";
+	bool inverted = circulant ? inverse_circulant(T.col, IA) : inverse_toeplitz(T.col, T.row, IA);
+	double toeplitz_time = timer.tick();
+	if(not inverted){
+		fprintf(stderr, "%s: can't be inverted in O(n*n), inverting with the LU decomposition\n", kind);
+		return false;
+	}
+	
+	// Levinson doesn't pivot, check the accuracy
+	if(not estimateInverse(T, IA, kind))
+		return false;
+	cout<<"# Tempo "<< kind <<": "<< toeplitz_time <<"\n";
+	return true;
+}
+
+void invertGenerator(Args& args){
+	size_t size = args.size, next;
+	if(args.input)
+		cin>> size;
+	varray<double> col(size), row(size);
+	if(args.input)
+		readGenerator(col, row);
+	else
+		randomGenerator(col, row);
+	setupKernels<double>(args, size);
+	
+	ToeplitzMatrix T(col, row);
+	MatrixColMajor<double> IA(size);
+	while(true){
+		cout<< scientific;
+		total_time_iter = total_time_residue = 0;
+		if(not invertToeplitz(T, IA)){
+			// the LU decomposition needs the n*n matrix
+			Matrix<double> A(size);
+			toeplitzMatrix(A, col, row);
+			invertLU(A, IA, args);
+		}
+		cout<<"#\n";
+		printm(IA);
+		if(not args.sequence || not (cin>> next))
+			break;
+		if(next != size){
+			fprintf(stderr, "Matrices of the sequence must be %zux%zu\n", size, size);
+			exit(EXIT_FAILURE);
+		}
+		readGenerator(col, row);
+	}
+}
+
+bool invertComponents(Matrix<double>& A, MatrixColMajor<double>& IA, Args& args){
+	// one refining iteration per block, the residues are all calculated anyway
+	const long defaultIter = 1;
+	vector< vector<size_t> > blocks;
+	
+	timer.start();
+	components(A, blocks);
+	if(blocks.size() < 2)
+		return false;
+	size_t largest = 0;
+	for(size_t b = 0; b < blocks.size(); ++b)
+		largest = max(largest, blocks[b].size());
+	size_t threads = min((size_t)thread::hardware_concurrency(), blocks.size());
+	long iter_n = args.iter_n == -1 ? defaultIter : args.iter_n;
+	vector<double> residues;
+	bool inverted = inverse_components(A, IA, blocks, iter_n, residues, max(threads, (size_t)1));
+	double components_time = timer.tick();
+	if(not inverted){
+		fprintf(stderr, "Singular diagonal block, inverting with the LU decomposition\n");
+		return false;
+	}
+	
+	// the blocks are decoupled, their residues add up as the squares of the norm
+	double err = 0;
+	for(size_t b = 0; b < residues.size(); ++b)
+		err += residues[b]*residues[b];
+	cout<<"# Componentes: "<< blocks.size() <<", maior bloco: "<< largest <<"\n";
+	cout<< scientific;
+	cout<<"# Residuo: "<< sqrt(err) <<"\n";
+	cout<< defaultfloat;
+	cout<<"# Tempo componentes: "<< components_time <<"\n";
+	return true;
+}
+
+void determinant(Matrix<double>& A, Args& args, varray<double>& Rs, varray<double>& Cs){
+	size_t size = A.size();
+	Matrix<double> LU(size);
+	varray<size_t> P(A.sizeMem());
+	
+	timer.start();
+	bool factored = GaussElChecked(A, LU, P);
+	lu_time = timer.tick();
+	
+	// a zero pivot: singular, its determinant is 0
+	int sign = 0;
+	double logDet = -INFINITY;
+	if(factored)
+		logDet = logDeterminant(LU, P, sign);
+	// A was scaled by Rs and Cs, powers of 2: exact in the log
+	if(args.equilibrate)
+		for(size_t i = 0; i < size; ++i)
+			logDet -= log(Rs.at(i)) + log(Cs.at(i));
+	cout<< defaultfloat;
+	cout<<"# Tempo LU: "<< lu_time <<"\n";
+	printDeterminant(logDet, sign, args);
+}
+
+void printDeterminant(double logDet, int sign, Args& args){
+	cout<< scientific;
+	cout<<"#\n";
+	if(args.logdet)
+		cout<< sign <<" "<< logDet <<"\n";
+	else
+		cout<< (sign == 0 ? 0 : sign*exp(logDet)) <<"\n";
+}
+
+void invertSparse(Args& args){
+	// one refining iteration, sparse residues are cheap
+	const long defaultIter = 1;
+	size_t size = args.size;
+	SparseMatrix A(size);
+	if(args.input){
+		cin>> size;
+		args.size = size;
+		readSparse(A, size);
+	} else {
+		// random values on the 5 point stencil of a square grid, like a discretized PDE
+		size_t side = (size_t)ceil(sqrt((double)size));
+		double invRandMax = 1.0/(double)RAND_MAX;
+		vector<size_t> I, J;
+		vector<double> V;
+		for(size_t j = 0; j < size; ++j){
+			size_t nb[] = {j - side, j - 1, j + 1, j + side};
+			bool in[] = {j >= side, j % side != 0, (j+1) % side != 0, j + side < size};
+			I.push_back(j); J.push_back(j);
+			V.push_back(4 + (double)rand() * invRandMax);
+			for(size_t k = 0; k < 4; ++k){
+				if(in[k] && nb[k] < size){
+					I.push_back(nb[k]); J.push_back(j);
+					V.push_back(-(double)rand() * invRandMax);
+				}
+			}
+		}
+		A.fromTriplets(size, I, J, V);
+	}
+	for(size_t c = 0; c < args.columns.size(); ++c){
+		if(args.columns[c] >= size){
+			fprintf(stderr, "Column %zu out of the matrix\n", args.columns[c]);
+			exit(EXIT_FAILURE);
+		}
+	}
+	// columns of the inverse to calculate, all of them for the diagonal or the whole inverse
+	vector<size_t> cols = args.columns;
+	if(cols.empty())
+		for(size_t j = 0; j < size; ++j)
+			cols.push_back(j);
+	long iter_n = args.iter_n == -1 ? defaultIter : args.iter_n;
+	
+	timer.start();
+	SparseSymbolic S(A);
+	double analysis_time = timer.tick();
+	SparseLU LU;
+	bool first = true;
+	do {
+		timer.start();
+		if(not LU.factor(A, S)){
+			fprintf(stderr, "Sparse matrix is singular\n");
+			exit(EXIT_FAILURE);
+		}
+		lu_time = timer.tick();
+		if(args.det || args.logdet){
+			int sign;
+			double logDet = LU.logDeterminant(sign);
+			cout<< defaultfloat;
+			cout<<"# Tempo LU: "<< lu_time <<"\n";
+			printDeterminant(logDet, sign, args);
+			first = false;
+			continue;
+		}
+		
+		// each column solved and refined with the O(nnz) residue, O(n) memory per column
+		timer.start();
+		varray<double> E(size), X(size), R(size), W(size), Y(size);
+		// only what is printed is kept: the diagonal, the columns or the whole inverse
+		bool whole = not args.diagOnly && args.columns.empty();
+		MatrixColMajor<double> IA(whole ? size : 0);
+		varray<double> D(args.diagOnly ? size : 0);
+		vector< varray<double> > C(args.diagOnly ? 0 : args.columns.size());
+		for(size_t c = 0; c < C.size(); ++c)
+			C[c].alloc(size);
+		double err = 0;
+		for(size_t i = 0; i < size; ++i)
+			E.at(i) = 0;
+		for(size_t c = 0; c < cols.size(); ++c){
+			E.at(cols[c]) = 1;
+			LU.solve(X, E, Y);
+			double errNorm = A.residue(X, E, R);
+			for(long it = 0; it < iter_n; ++it){
+				LU.solve(W, R, Y);
+				for(size_t i = 0; i < size; ++i)
+					X.at(i) += W.at(i);
+				errNorm = A.residue(X, E, R);
+			}
+			err += errNorm;
+			E.at(cols[c]) = 0;
+			if(args.diagOnly)
+				D.at(c) = X.at(cols[c]);
+			else if(args.columns.empty())
+				for(size_t i = 0; i < size; ++i)
+					IA.at(i,c) = X.at(i);
+			else
+				for(size_t i = 0; i < size; ++i)
+					C[c].at(i) = X.at(i);
+		}
+		double solve_time = timer.tick();
+		
+		cout<< defaultfloat;
+		if(first)
+			cout<<"# Tempo analise: "<< analysis_time <<"\n";
+		cout<<"# Nao nulos: "<< A.nnz() <<", LU: "<< LU.nnz() <<"\n";
+		cout<< scientific;
+		cout<<"# Residuo: "<< sqrt(err) <<"\n";
+		cout<< defaultfloat;
+		cout<<"# Tempo LU: "<< lu_time <<"\n";
+		cout<<"# Tempo solucoes: "<< solve_time <<"\n";
+		cout<<"#\n";
+		if(args.diagOnly){
+			cout<< size <<"\n";
+			printv(D);
+			cout<<"\n";
+		} else if(not args.columns.empty()){
+			cout<< size <<" "<< cols.size() <<"\n";
+			for(size_t i = 0; i < size; ++i){
+				for(size_t c = 0; c < cols.size(); ++c)
+					cout<< C[c].at(i) <<" ";
+				cout<<"\n";
+			}
+		} else {
+			printm(IA);
+		}
+		first = false;
+		// next matrices of the sequence reuse the symbolic analysis
+	} while(args.sequence && readNextSparse(A));
+}
+
+template<class AMatrix>
+bool estimateInverse(AMatrix& A, MatrixColMajor<double>& IA, const char* label){
+	size_t size = A.size();
+	varray<double> X(size), Y(size), Z(size);
+	double err = residueEstimate(A, IA, 4, X, Y, Z);
+	cout<< scientific;
+	cout<<"# "<< label <<", residuo estimado: "<< err <<"\n";
+	if(err >= 1){
+		fprintf(stderr, "%s: inverse is not accurate, inverting with the LU decomposition\n", label);
+		return false;
+	}
+	cout<< defaultfloat;
+	return true;
+}
+
+bool checkInverse(Matrix<double>& A, MatrixColMajor<double>& IA, long iter_n, const char* label){
+	if(not estimateInverse(A, IA, label))
+		return false;
+	cout<< scientific;
+	if(iter_n > 0 && iter_n != -1){
+		total_time_iter = total_time_residue = 0;
+		refine_newton_schulz(A, IA, iter_n);
+	}
+	cout<< defaultfloat;
+	return true;
+}
+
+void removeIndex(Growable<double>& A, Growable<double, MatrixColMajor>& IA, Args& args,
+GrowableArray<double>& Rs, GrowableArray<double>& Cs){
+	size_t k = args.remove;
+	timer.start();
+	if(not border_remove(IA, k)){
+		fprintf(stderr, "A without row and column %zu is singular\n", k);
+		exit(EXIT_FAILURE);
+	}
+	double remove_time = timer.tick();
+	removeRowCol(A, k);
+	if(args.equilibrate){
+		removeAt(Rs, k);
+		removeAt(Cs, k);
+	}
+	
+	size_t size = A.size();
+	varray<double> X(size), Y(size), Z(size);
+	cout<< scientific;
+	cout<<"# Remocao de "<< k <<", residuo estimado: "<< residueEstimate(A, IA, 4, X, Y, Z) <<"\n";
+	cout<< defaultfloat;
+	cout<<"# Tempo remocao: "<< remove_time <<"\n";
+}
+
+bool parseSize(const char* s, size_t& x){
+	char* end;
+	errno = 0;
+	long long n = strtoll(s, &end, 10);
+	if(end == s || *end != '\0' || errno == ERANGE || n < 0)
+		return false;
+	x = n;
+	return true;
+}
+
+void parseArgs(int& argc, char**& argv, Args& args, ifstream& in_f, ofstream& o_f){
 	int c;
-	input = true;
-	size = 0; iter_n = -1;
-#define errMsg "Usage: %s [-e inputFile] [-o outputFile] [-r randSize] -i Iterations\n"
-	while ((c = getopt(argc, argv, "e:o:r:i:")) != -1){
+	args.input = true;
+	args.size = 0; args.iter_n = -1;
+	args.probes = 0; args.tol = 0;
+	args.newton = false;
+	args.block = false;
+	args.equilibrate = false;
+	args.diagOnly = false;
+	args.columns.clear();
+	args.updateFile = args.inverseFile = NULL;
+	args.border = false;
+	args.remove = -1;
+	args.sequence = false;
+	args.dense = false;
+	args.toeplitz = false;
+	args.sparse = false;
+	args.det = args.logdet = false;
+	args.tiled = false;
+	args.precision = "double";
+	args.isa.clear();
+	args.tune = false;
+	args.profile = defaultProfile();
+#define errMsg "Usage: %s [-e inputFile] [-o outputFile] [-r randSize] [-s Probes] [-t Tolerance] [-n] [-b] [-q] [--diag-only | --columns c0,c1,...] [--update UVFile] [--inverse IAFile] [--border] [--remove k] [--sequence] [--dense] [--toeplitz] [--sparse] [--det | --logdet] [--tiled] [--alloc p0,p1,...] [--precision float|double|complex|complex-float] [--isa generic|avx2|avx512] [--cache L1,L2,L3] [--tile b] [--tune] [--profile file] [-i Iterations]\n"
+	static struct option longOpts[] = {
+		{"diag-only", no_argument, NULL, 'd'},
+		{"columns", required_argument, NULL, 'c'},
+		{"update", required_argument, NULL, 'u'},
+		{"inverse", required_argument, NULL, 'v'},
+		{"border", no_argument, NULL, 'g'},
+		{"remove", required_argument, NULL, 'x'},
+		{"sequence", no_argument, NULL, 'S'},
+		{"dense", no_argument, NULL, 'D'},
+		{"toeplitz", no_argument, NULL, 'T'},
+		{"sparse", no_argument, NULL, 'P'},
+		{"det", no_argument, NULL, 'M'},
+		{"logdet", no_argument, NULL, 'L'},
+		{"tiled", no_argument, NULL, 'B'},
+		{"alloc", required_argument, NULL, 'A'},
+		{"precision", required_argument, NULL, 'F'},
+		{"isa", required_argument, NULL, 'I'},
+		{"cache", required_argument, NULL, 'C'},
+		{"tile", required_argument, NULL, 'W'},
+		{"tune", no_argument, NULL, 'U'},
+		{"profile", required_argument, NULL, 'R'},
+		{NULL, 0, NULL, 0}
+	};
+	while ((c = getopt_long(argc, argv, "e:o:r:i:s:t:nbq", longOpts, NULL)) != -1){
 		switch (c){
 			case 'e':
 				// inputFile
@@ -98,11 +1083,134 @@ bool& input, size_t& size, size_t& iter_n, ifstream& in_f, ofstream& o_f){
 				cout.rdbuf(o_f.rdbuf()); //redirect
 				break;
 			case 'r':	//Generate random matrix
-				input = false;
-				size = stol(optarg);
+				args.input = false;
+				args.size = stol(optarg);
 				break;
 			case 'i':
-				iter_n = stol(optarg);
+				args.iter_n = stol(optarg);
+				break;
+			case 's':	//Estimate residue with random probes
+				args.probes = stol(optarg);
+				break;
+			case 't':	//Stop refining when residue is below
+				args.tol = stod(optarg);
+				break;
+			case 'n':	//Newton-Schulz refining
+				args.newton = true;
+				break;
+			case 'b':	//Block recursive inversion
+				args.block = true;
+				break;
+			case 'q':	//Equilibrate input
+				args.equilibrate = true;
+				break;
+			case 'd':	//Only the diagonal of the inverse
+				args.diagOnly = true;
+				break;
+			case 'c':{	//Only some columns of the inverse
+				stringstream list(optarg);
+				string col;
+				while(getline(list, col, ','))
+					args.columns.push_back(stol(col));
+				break;
+			}
+			case 'u':	//Low rank update of the inverse
+				args.updateFile = optarg;
+				break;
+			case 'v':	//Inverse to be updated
+				args.inverseFile = optarg;
+				break;
+			case 'g':	//Bordered inversion
+				args.border = true;
+				break;
+			case 'x':	//Remove a row and column from the inverse
+				args.remove = stol(optarg);
+				break;
+			case 'S':	//Sequence of matrices with the same structure
+				args.sequence = true;
+				break;
+			case 'D':	//Always invert as dense
+				args.dense = true;
+				break;
+			case 'T':	//Toeplitz generator input
+				args.toeplitz = true;
+				break;
+			case 'P':	//Sparse input
+				args.sparse = true;
+				break;
+			case 'M':	//Determinant only
+				args.det = true;
+				break;
+			case 'L':	//Log-determinant only
+				args.logdet = true;
+				break;
+			case 'B':	//Tiled storage for the LU inversion
+				args.tiled = true;
+				break;
+			case 'A':{	//Allocation policies of the LU
+				stringstream list(optarg);
+				string policy;
+				while(getline(list, policy, ',')){
+					if(policy == "huge") args.alloc.huge = true;
+					else if(policy == "interleave") args.alloc.interleave = true;
+					else if(policy == "populate") args.alloc.populate = true;
+					else if(policy == "touch") args.alloc.parallelTouch = true;
+					else {
+						fprintf(stderr, "Unknown allocation policy %s\n", policy.c_str());
+						exit(EXIT_FAILURE);
+					}
+				}
+				break;
+			}
+			case 'F':	//Elem type of the LU inversion
+				args.precision = optarg;
+				if(args.precision != "float" && args.precision != "double"
+				&& args.precision != "complex" && args.precision != "complex-float"){
+					fprintf(stderr, "Unknown precision %s\n", optarg);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 'I':{	//Instruction set of the kernels
+				Isa isa;
+				if(not isaFromName(optarg, isa)){
+					fprintf(stderr, "Unknown instruction set %s\n", optarg);
+					exit(EXIT_FAILURE);
+				}
+				args.isa = optarg;
+				break;
+			}
+			case 'C':{	//Cache sizes the kernels are tiled for
+				stringstream list(optarg);
+				string kib;
+				size_t n;
+				size_t* levels[] = { &cacheTopology().l1, &cacheTopology().l2, &cacheTopology().l3 };
+				for(size_t l = 0; l < 3 && getline(list, kib, ','); ++l){
+					if(not parseSize(kib.c_str(), n)){
+						fprintf(stderr, "Invalid cache size %s\n", kib.c_str());
+						fprintf(stderr, errMsg, argv[0]);
+						exit(EXIT_FAILURE);
+					}
+					*levels[l] = n*1024;
+				}
+				if(cacheTopology().l1 == 0){
+					fprintf(stderr, "L1 cache can't be empty\n");
+					exit(EXIT_FAILURE);
+				}
+				cacheTopology().source = "argumentos";
+				break;
+			}
+			case 'W':	//L1 tile of the kernels
+				if(not parseSize(optarg, cacheTopology().tile)){
+					fprintf(stderr, "Invalid tile %s\n", optarg);
+					fprintf(stderr, errMsg, argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 'U':	//Autotune the kernels
+				args.tune = true;
+				break;
+			case 'R':	//Profile of the kernel parameters
+				args.profile = optarg;
 				break;
 			case ':':
 			// missing option argument
@@ -113,15 +1221,196 @@ bool& input, size_t& size, size_t& iter_n, ifstream& in_f, ofstream& o_f){
 				exit(EXIT_FAILURE);
 		}
 	}
-	
-	if(iter_n == -1){
-		fprintf(stderr, errMsg, argv[0]);
-		fprintf(stderr, "-i Iterations is not optional\n");
+	if(args.equilibrate && args.inverseFile){
+		fprintf(stderr, "-q can't be used with a given inverse\n");
+		exit(EXIT_FAILURE);
+	}
+	if(args.sparse && (args.equilibrate || args.inverseFile || args.updateFile)){
+		fprintf(stderr, "--sparse can't be used with -q, --inverse or --update\n");
+		exit(EXIT_FAILURE);
+	}
+	if(args.sequence && (not args.input || args.remove != -1)){
+		fprintf(stderr, "--sequence needs an input file of same sized matrices\n");
+		exit(EXIT_FAILURE);
+	}
+	if(args.precision != "double" && (args.equilibrate || args.block || args.updateFile
+	|| args.inverseFile || args.border || args.remove != -1 || args.toeplitz || args.sparse
+	|| args.det || args.logdet || args.diagOnly || not args.columns.empty() || args.tiled)){
+		fprintf(stderr, "--precision other than double only inverts with the LU decomposition, -n, -s, -t, -i and --sequence\n");
+		exit(EXIT_FAILURE);
+	}
+	if(args.tune && (args.sparse || args.toeplitz)){
+		fprintf(stderr, "--tune needs a dense input matrix, or -r\n");
 		exit(EXIT_FAILURE);
 	}
 #undef errMsg
 }
 
+template<class Elem>
+void setupKernels(Args& args, size_t size){
+	Tuning& t = tuning();
+	bool loaded = size > 0 && loadTuning<Elem>(args.profile.c_str(), size, t);
+	Isa isa = t.isa;
+	if(not args.isa.empty())
+		isaFromName(args.isa.c_str(), isa);
+	if(not setIsa(isa))
+		fprintf(stderr, "CPU doesn't support %s, using %s\n", isaName(isa), isaName(activeIsa()));
+	cout<<"# Instrucoes: "<< isaName(activeIsa()) <<"\n";
+	printCacheTopology();
+	if(loaded)
+		cout<<"# Perfil "<< args.profile <<": "<< profileLine(elemName<Elem>(), sizeBucket(size), t) <<"\n";
+}
+
+template<class Elem>
+void tuneKernels(Args& args){
+	size_t size = args.size;
+	Matrix<Elem> A;
+	if(args.input){
+		cin>> size;
+		A.alloc(size);
+		readMatrix(A);
+	} else {
+		A.alloc(size);
+		for(size_t i = 0; i < size; ++i)
+			for(size_t j = 0; j < size; ++j)
+				A.at(i,j) = randomElem<Elem>();
+	}
+	// tunes from the defaults, not from a previous profile
+	Tuning& t = tuning();
+	t = Tuning();
+	setupKernels<Elem>(args, 0);
+	cout<<"# Precisao: "<< elemName<Elem>() <<"\n";
+	
+	Matrix<Elem> LU(size);
+	MatrixColMajor<Elem> IA(size), I(size), Z(size), R(size);
+	varray<size_t> P(A.sizeMem());
+	assign(I, IdentityExpr<Elem>());
+	
+	cout<<"#\n";
+	Isa best = activeIsa();
+	double bestTime = -1;
+	for(int i = 0; i <= (int)detectIsa(); ++i){
+		Isa isa = (Isa)i;
+		if(not args.isa.empty() && isa != activeIsa())
+			continue; // given, not tuned
+		setIsa(isa);
+		double time = timeBest([&]{ GaussEl(A, LU, P); });
+		cout<<"# Ajuste LU "<< isaName(isa) <<": "<< time <<"\n";
+		if(bestTime < 0 || time < bestTime){
+			bestTime = time;
+			best = isa;
+		}
+	}
+	t.isa = best;
+	setIsa(best);
+	GaussEl(A, LU, P);
+	
+	tuneKernel<Elem>(t.subst, "subst", size, [&]{ solveMLU0(LU, IA, I, P, Z); });
+	tuneKernel<Elem>(t.residue, "residuo", size, [&]{ residue0AUIJ(A, IA, R); });
+	
+	cout<<"#\n";
+	cout<<"# Escolhido: "<< profileLine(elemName<Elem>(), sizeBucket(size), t) <<"\n";
+	if(saveTuning(args.profile.c_str(), elemName<Elem>(), size, t))
+		cout<<"# Perfil salvo em "<< args.profile <<"\n";
+	else
+		fprintf(stderr, "Could not write the profile %s\n", args.profile.c_str());
+}
+
+template<class Elem>
+double tuneKernel(KernelTuning& k, const char* name, size_t size, const function<void()>& run){
+	auto timed = [&]{
+		double best = timeBest(run);
+		cout<<"# Ajuste "<< name <<" bloco "<< k.tileOf<Elem>() <<" unroll "<< k.iunr <<"x"<< k.junr
+			<<": "<< best <<"\n";
+		return best;
+	};
+	KernelTuning best = k;
+	double bestTime = -1;
+	// Elem compiled with the default unrolling only
+	size_t unrolls = Unroll<Elem,2,4>::tuned ? unrollCandidatesN : 1;
+	for(size_t u = 0; u < unrolls; ++u){
+		k.iunr = unrollCandidates[u][0];
+		k.junr = unrollCandidates[u][1];
+		double time = timed();
+		if(bestTime < 0 || time < bestTime){
+			bestTime = time;
+			best = k;
+		}
+	}
+	k = best;
+	if(cacheTopology().tile != 0)
+		return bestTime; // given, not tuned
+	// tiles of whole lines, up to the matrix
+	const size_t lines[] = { 2, 3, 4, 6, 8, 12, 16 };
+	size_t lineN = cacheTopology().line/sizeof(Elem) > 0 ? cacheTopology().line/sizeof(Elem) : 1;
+	for(size_t l = 0; l < sizeof(lines)/sizeof(lines[0]); ++l){
+		k.tile = lines[l]*lineN;
+		if(k.tile > size && l > 0)
+			break;
+		double time = timed();
+		if(time < bestTime){
+			bestTime = time;
+			best = k;
+		}
+	}
+	k = best;
+	return bestTime;
+}
+
+double timeBest(const function<void()>& run, size_t reps){
+	run();
+	double best = -1;
+	for(size_t r = 0; r < reps; ++r){
+		timer.start();
+		run();
+		double time = timer.tick();
+		if(best < 0 || time < best)
+			best = time;
+	}
+	return best;
+}
+
+size_t refiningIterations(double cond, double eps){
+	const size_t maxIter = 30;
+	// error reduction of each refining iteration
+	double rate = cond * eps;
+	// error at the rounding level of the residue, not worth refining
+	const double floor = 1e3 * eps;
+	if(rate >= 1){
+		fprintf(stderr, "Matrix is too ill-conditioned, refining may not converge\n");
+		return maxIter;
+	}
+	if(rate <= floor)
+		return 0;
+	return min((size_t)ceil(log(floor)/log(rate)) - 1, maxIter);
+}
+
+size_t newtonIterations(double err, double cond, double eps){
+	const size_t maxIter = 30;
+	// rounding level of the residue, not worth refining below it
+	double floor = max(1e3 * eps, cond * eps);
+	if(err <= floor)
+		return 0;
+	if(err >= 1)
+		return 1; // refine_newton_schulz tells if it can't converge
+	// err^(2^m) <= floor
+	return min((size_t)ceil(log2(log(floor)/log(err))), maxIter);
+}
+
+void pickRefining(double cond, Refining& r, double eps){
+	double rate = cond * eps;
+	r.iter_n = refiningIterations(cond, eps);
+	if(rate < 1 && r.iter_n > 2 && r.probes == 0){
+		// slow convergence, Newton-Schulz converges quadratically instead
+		r.newton = true;
+		r.iter_n = (size_t)ceil(log2((double)r.iter_n)) + 1;
+	} else if(r.iter_n > 2 && r.probes == 0){
+		// may not converge, monitor it with the cheap residue estimate
+		r.probes = 4;
+	}
+	cout<<"# Iteracoes: "<< r.iter_n <<"\n";
+}
+
 
 
 
@@ -137,10 +1426,10 @@ int mainT(int argc, char **argv)
 	ofstream o_f;
 	streambuf* coutbuf = cout.rdbuf(); //save old buf;
 	
-	bool input;
-	size_t size, iter_n;
+	Args args;
+	size_t size;
 	
-	parseArgs(argc, argv, input, size, iter_n, in_f, o_f);
+	parseArgs(argc, argv, args, in_f, o_f);
 	
 	/**
 	vector<size_t> V_sz = {8192/4,8192/2};